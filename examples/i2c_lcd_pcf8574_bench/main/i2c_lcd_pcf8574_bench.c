@@ -0,0 +1,121 @@
+// Benchmark of the i2c_lcd_pcf8574 driver on a 20x4 display: every workload at 100kHz and 400kHz,
+// one JSON object per line on the console. host/lcd_host_bench.c runs the same workloads against
+// the emulated display.
+
+#include <stdio.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "sdkconfig.h"
+#include "esp_log.h"
+#include "i2c_lcd_pcf8574.h"
+#include "lcd_bench.h"
+
+#define I2C_MASTER_SCL_IO 22        // GPIO number for I2C master clock
+#define I2C_MASTER_SDA_IO 21        // GPIO number for I2C master data
+#define I2C_MASTER_NUM I2C_NUM_0    // I2C port number for master dev
+
+#define LCD_ADDR 0x27               // I2C address of the LCD
+#define LCD_COLS 20                 // Number of columns in the LCD
+#define LCD_ROWS 4                  // Number of rows in the LCD
+
+static const char *TAG = "LCD_BENCH";
+
+static const uint32_t s_clocks_hz[] = { 100000, 400000 };
+
+static i2c_lcd_pcf8574_handle_t s_lcd;
+
+#if CONFIG_HEAP_USE_HOOKS
+static volatile uint32_t s_allocs;
+
+// Called by the heap component for every allocation
+void esp_heap_trace_alloc_hook(void* ptr, size_t size, uint32_t caps)
+{
+    s_allocs++;
+    // Aborts on an allocation inside a driver call with CONFIG_LCD_PCF8574_ASSERT_NO_ALLOC
+    lcd_check_alloc(&s_lcd);
+}
+
+static uint32_t bench_allocs(void)
+{
+    return s_allocs;
+}
+#define BENCH_ALLOCS bench_allocs
+#else
+// No heap hooks
+#define BENCH_ALLOCS NULL
+#endif
+
+#if CONFIG_LCD_PCF8574_I2C_MASTER
+static i2c_master_bus_handle_t s_bus;
+
+// Add the display to the bus at the given clock
+static i2c_master_dev_handle_t i2c_master_init(uint32_t clock_hz)
+{
+    if (s_bus == NULL) {
+        i2c_master_bus_config_t bus_config = {
+            .i2c_port = I2C_MASTER_NUM,
+            .sda_io_num = I2C_MASTER_SDA_IO,
+            .scl_io_num = I2C_MASTER_SCL_IO,
+            .clk_source = I2C_CLK_SRC_DEFAULT,
+            .glitch_ignore_cnt = 7,
+            .flags.enable_internal_pullup = true,
+        };
+        ESP_ERROR_CHECK(i2c_new_master_bus(&bus_config, &s_bus));
+    }
+    i2c_device_config_t dev_config = {
+        .dev_addr_length = I2C_ADDR_BIT_LEN_7,
+        .device_address = LCD_ADDR,
+        .scl_speed_hz = clock_hz,
+    };
+    i2c_master_dev_handle_t dev;
+    ESP_ERROR_CHECK(i2c_master_bus_add_device(s_bus, &dev_config, &dev));
+    return dev;
+}
+#else
+// Install the legacy driver at the given clock
+static void i2c_master_init(uint32_t clock_hz)
+{
+    i2c_config_t conf = {
+        .mode = I2C_MODE_MASTER,
+        .sda_io_num = I2C_MASTER_SDA_IO,
+        .sda_pullup_en = GPIO_PULLUP_ENABLE,
+        .scl_io_num = I2C_MASTER_SCL_IO,
+        .scl_pullup_en = GPIO_PULLUP_ENABLE,
+        .master.clk_speed = clock_hz,
+    };
+    ESP_ERROR_CHECK(i2c_param_config(I2C_MASTER_NUM, &conf));
+    ESP_ERROR_CHECK(i2c_driver_install(I2C_MASTER_NUM, conf.mode, 0, 0, 0));
+}
+#endif
+
+void app_main(void)
+{
+    const lcd_bench_platform_t platform = {
+        .target = CONFIG_IDF_TARGET,
+        .allocs = BENCH_ALLOCS,
+    };
+
+    for (size_t i = 0; i < sizeof(s_clocks_hz) / sizeof(s_clocks_hz[0]); i++) {
+        ESP_LOGI(TAG, "Running at %lu Hz", (unsigned long)s_clocks_hz[i]);
+        ESP_ERROR_CHECK(lcd_init(&s_lcd, LCD_ADDR, I2C_MASTER_NUM));
+#if CONFIG_LCD_PCF8574_I2C_MASTER
+        i2c_master_dev_handle_t dev = i2c_master_init(s_clocks_hz[i]);
+        lcd_transport_t transport;
+        lcd_transport_i2c_master(&transport, dev);
+        ESP_ERROR_CHECK(lcd_set_transport(&s_lcd, &transport));
+#else
+        i2c_master_init(s_clocks_hz[i]);
+#endif
+        ESP_ERROR_CHECK(lcd_begin(&s_lcd, LCD_COLS, LCD_ROWS));
+        lcd_set_backlight(&s_lcd, 255);
+
+        lcd_bench_run(&s_lcd, s_clocks_hz[i], &platform, stdout);
+
+#if CONFIG_LCD_PCF8574_I2C_MASTER
+        ESP_ERROR_CHECK(i2c_master_bus_rm_device(dev));
+#else
+        ESP_ERROR_CHECK(i2c_driver_delete(I2C_MASTER_NUM));
+#endif
+    }
+    ESP_LOGI(TAG, "Done");
+}
@@ -0,0 +1,121 @@
+// Driver benchmark: runs each workload a fixed number of times and reports the time per call,
+// characters per second, bytes and transactions per call from the performance counters, the time
+// spent waiting for the controller and the heap allocations per call.
+
+#include <stdio.h>
+#include <string.h>
+#include "esp_timer.h"
+#include "lcd_bench.h"
+
+// Version of the output format, bumped when a field changes its meaning
+#define LCD_BENCH_FORMAT 1
+
+// Characters per call that depend on the geometry
+#define LCD_BENCH_CHARS_ROW    0xFFFF
+#define LCD_BENCH_CHARS_SCREEN 0xFFFE
+
+typedef struct
+{
+    const char* name;
+    uint32_t iterations;
+    uint32_t chars;             // Characters each call writes, 0 for commands only
+    esp_err_t (*run)(i2c_lcd_pcf8574_handle_t* lcd, uint32_t i);
+} lcd_bench_workload_t;
+
+static const uint8_t s_glyph[2][8] = {
+    { 0x04, 0x0E, 0x0E, 0x0E, 0x1F, 0x00, 0x04, 0x00 },
+    { 0x00, 0x0A, 0x1F, 0x1F, 0x0E, 0x04, 0x00, 0x00 },
+};
+
+static lcd_field_t s_field;
+
+// One row of text at the start of the first row
+static esp_err_t lcd_bench_print(i2c_lcd_pcf8574_handle_t* lcd, uint32_t i) {
+    char text[LCD_DDRAM_SIZE + 1];
+    memset(text, 'A' + i % 26, lcd->cols);
+    text[lcd->cols] = '\0';
+    lcd_set_cursor(lcd, 0, 0);
+    return lcd_print(lcd, text);
+}  // lcd_bench_print()
+
+static esp_err_t lcd_bench_print_number(i2c_lcd_pcf8574_handle_t* lcd, uint32_t i) {
+    return lcd_print_number(lcd, 0, 1, 9, "%8lu", (unsigned long)i);
+}  // lcd_bench_print_number()
+
+static esp_err_t lcd_bench_create_char(i2c_lcd_pcf8574_handle_t* lcd, uint32_t i) {
+    return lcd_create_char(lcd, i % 8, (uint8_t*)s_glyph[i % 2]);
+}  // lcd_bench_create_char()
+
+static esp_err_t lcd_bench_clear(i2c_lcd_pcf8574_handle_t* lcd, uint32_t i) {
+    return lcd_clear(lcd);
+}  // lcd_bench_clear()
+
+// Every cell changes: the worst case of a framebuffer flush
+static esp_err_t lcd_bench_repaint(i2c_lcd_pcf8574_handle_t* lcd, uint32_t i) {
+    for (uint8_t row = 0; row < lcd->lines; row++) {
+        for (uint8_t col = 0; col < lcd->cols; col++) {
+            lcd_fb_write(lcd, col, row, (i % 2) ? 'a' + (col + row) % 26 : '0' + (col + row) % 10);
+        }
+    }
+    return lcd_flush(lcd);
+}  // lcd_bench_repaint()
+
+// A counter in a numeric field: one or two digits change per call
+static esp_err_t lcd_bench_field(i2c_lcd_pcf8574_handle_t* lcd, uint32_t i) {
+    return lcd_field_update(lcd, &s_field, i);
+}  // lcd_bench_field()
+
+static const lcd_bench_workload_t s_workloads[] = {
+    { "lcd_print", 50, LCD_BENCH_CHARS_ROW, lcd_bench_print },
+    { "lcd_print_number", 100, 8, lcd_bench_print_number },
+    { "lcd_create_char", 50, 0, lcd_bench_create_char },
+    { "lcd_clear", 20, 0, lcd_bench_clear },
+    { "repaint", 20, LCD_BENCH_CHARS_SCREEN, lcd_bench_repaint },
+    { "field_update", 200, 0, lcd_bench_field },
+};
+
+// Run every workload and print its results
+void lcd_bench_run(i2c_lcd_pcf8574_handle_t* lcd, uint32_t clock_hz, const lcd_bench_platform_t* platform, FILE* out) {
+    for (size_t w = 0; w < sizeof(s_workloads) / sizeof(s_workloads[0]); w++) {
+        const lcd_bench_workload_t* workload = &s_workloads[w];
+        const uint32_t chars = (workload->chars == LCD_BENCH_CHARS_ROW) ? lcd->cols
+                             : (workload->chars == LCD_BENCH_CHARS_SCREEN) ? lcd->cols * lcd->lines : workload->chars;
+        int64_t min_us = INT64_MAX;
+        int64_t max_us = 0;
+        uint32_t errors = 0;
+        lcd_perf_t perf;
+
+        // Start each workload from the same state
+        lcd_clear(lcd);
+        lcd_fb_clear(lcd);
+        lcd_field_init(&s_field, 0, 0, 6, 0, LCD_ALIGN_RIGHT);
+        lcd_perf_reset(lcd);
+        const uint32_t allocs = platform->allocs ? platform->allocs() : 0;
+        const int64_t start = esp_timer_get_time();
+        for (uint32_t i = 0; i < workload->iterations; i++) {
+            const int64_t call_start = esp_timer_get_time();
+            errors += workload->run(lcd, i) != ESP_OK;
+            const int64_t call_us = esp_timer_get_time() - call_start;
+            min_us = (call_us < min_us) ? call_us : min_us;
+            max_us = (call_us > max_us) ? call_us : max_us;
+        }
+        const int64_t total_us = esp_timer_get_time() - start;
+        const uint32_t call_allocs = platform->allocs ? platform->allocs() - allocs : 0;
+        lcd_perf_get(lcd, &perf);
+
+        const double n = workload->iterations;
+        fprintf(out, "{\"format\":%d,\"target\":\"%s\",\"workload\":\"%s\",\"clock_hz\":%lu,\"cols\":%u,\"rows\":%u,"
+                "\"iterations\":%lu,\"errors\":%lu,\"us_per_op\":%.1f,\"us_min\":%lld,\"us_max\":%lld,"
+                "\"chars_per_sec\":%.0f,\"bytes_per_op\":%.1f,\"transactions_per_op\":%.2f,"
+                "\"spin_us_per_op\":%.1f,\"sleep_us_per_op\":%.1f,",
+                LCD_BENCH_FORMAT, platform->target, workload->name, (unsigned long)clock_hz, lcd->cols, lcd->lines,
+                (unsigned long)workload->iterations, (unsigned long)errors, total_us / n, (long long)min_us,
+                (long long)max_us, total_us > 0 ? chars * n * 1e6 / total_us : 0.0, perf.bytes / n,
+                perf.transactions / n, perf.delay_us / n, perf.sleep_us / n);
+        if (platform->allocs) {
+            fprintf(out, "\"allocs_per_op\":%.2f}\n", call_allocs / n);
+        } else {
+            fprintf(out, "\"allocs_per_op\":null}\n");
+        }
+    }
+}  // lcd_bench_run()
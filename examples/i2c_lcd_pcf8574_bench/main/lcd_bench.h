@@ -0,0 +1,18 @@
+// Driver benchmark shared by the on-target app and the host build (host/lcd_host_bench.c).
+// Every workload prints one JSON object per line, see README.md of this example.
+
+#pragma once
+
+#include <stdio.h>
+#include <stdint.h>
+#include "i2c_lcd_pcf8574.h"
+
+// What the benchmark needs from where it runs
+typedef struct
+{
+    const char* target;         // "host" or the IDF target
+    uint32_t (*allocs)(void);   // Heap allocations so far, NULL if they can't be counted
+} lcd_bench_platform_t;
+
+// Run every workload on a display set up with lcd_begin() as cols x rows, on a bus at clock_hz
+void lcd_bench_run(i2c_lcd_pcf8574_handle_t* lcd, uint32_t clock_hz, const lcd_bench_platform_t* platform, FILE* out);
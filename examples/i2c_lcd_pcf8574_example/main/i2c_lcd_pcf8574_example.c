@@ -41,29 +41,34 @@ void app_main(void)
     ESP_LOGI(TAG, "Initializing LCD");
 
     i2c_lcd_pcf8574_handle_t lcd;
-    lcd_init(&lcd, LCD_ADDR, I2C_MASTER_NUM);
-    lcd_begin(&lcd, LCD_COLS, LCD_ROWS);
-
-    ESP_LOGI(TAG, "LCD initialized");
+    ESP_ERROR_CHECK(lcd_init(&lcd, LCD_ADDR, I2C_MASTER_NUM));
+    // Give up on a transaction after 50ms instead of 1s when the display does not answer
+    ESP_ERROR_CHECK(lcd_set_timeout(&lcd, 50));
+    if (lcd_begin(&lcd, LCD_COLS, LCD_ROWS) != ESP_OK) {
+        // The circuit breaker sets the display up as soon as it answers
+        ESP_LOGW(TAG, "LCD not responding");
+    } else {
+        ESP_LOGI(TAG, "LCD initialized");
+    }
 
     // Turn on the backlight
     lcd_set_backlight(&lcd, 255);
 
-    // Print a message
-    lcd_set_cursor(&lcd, 0, 0);
-    lcd_print(&lcd, "Hello, ESP32!");
-    lcd_set_cursor(&lcd, 0, 1);
-    lcd_print(&lcd, "LCD Test");
+    // Print a message: draw into the framebuffer, lcd_flush() sends it
+    lcd_fb_print(&lcd, 0, 0, "Hello, ESP32!");
+    lcd_fb_print(&lcd, 0, 1, "LCD Test");
+    lcd_flush(&lcd);
 
     int counter = 0;
     while (1) {
         vTaskDelay(20 / portTICK_PERIOD_MS);  // Wait for 1 second
 
-        // Update the counter on the LCD
-        lcd_set_cursor(&lcd, 10, 1);
+        // Update the counter on the LCD: only the digits that changed go over the bus
         char buffer[16];
         snprintf(buffer, sizeof(buffer), "%5d", counter);
-        lcd_print(&lcd, buffer);
+        lcd_fb_print(&lcd, 10, 1, buffer);
+        // Fails right away while the display is unplugged, the framebuffer comes back with it
+        lcd_flush(&lcd);
 
         counter++;
 
@@ -0,0 +1,357 @@
+/// \file fake_i2c.c
+/// \brief Fake I2C bus of the host build with a virtual clock
+///
+/// \author Femi Olugbon, https://iamflinks.github.io
+/// \copyright Copyright (c) 2024 by Femi Olugbon
+///
+/// ChangeLog see: i2c_lcd_pcf8574.h
+
+#include <stdlib.h>
+#include <string.h>
+#include "fake_i2c.h"
+#include "esp_timer.h"
+#include "esp_rom_sys.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+
+
+// Most operations one command link holds
+#define FAKE_I2C_LINK_OPS 16
+
+// Most esp_timer instances at a time, every display handle keeps one after lcd_begin()
+#define FAKE_I2C_TIMERS 32
+
+typedef enum {
+    FAKE_I2C_START,
+    FAKE_I2C_STOP,
+    FAKE_I2C_WRITE,
+    FAKE_I2C_READ,
+} fake_i2c_op_kind_t;
+
+typedef struct {
+    fake_i2c_op_kind_t kind;
+    uint8_t byte;
+    const uint8_t* data;
+    uint8_t* rx;
+    size_t len;
+} fake_i2c_op_t;
+
+typedef struct {
+    size_t count;
+    size_t capacity;
+    bool allocated;
+    fake_i2c_op_t ops[];
+} fake_i2c_link_t;
+
+struct esp_timer {
+    esp_timer_cb_t callback;
+    void* arg;
+    bool used;
+    bool armed;
+    int64_t due_us;
+};
+
+typedef struct {
+    i2c_port_t port;
+    uint8_t addr;
+    hd44780_emu_t* emu;
+} fake_i2c_device_t;
+
+static int64_t s_now_us;
+static fake_i2c_device_t s_devices[FAKE_I2C_MAX_DEVICES];
+static int s_device_count;
+static uint32_t s_clock_hz[I2C_NUM_MAX] = { FAKE_I2C_DEFAULT_HZ, FAKE_I2C_DEFAULT_HZ };
+static fake_i2c_stats_t s_stats[I2C_NUM_MAX];
+static struct esp_timer s_timers[FAKE_I2C_TIMERS];
+
+
+// Put an emulated display on a port, it answers to the given 7-bit address
+esp_err_t fake_i2c_attach(i2c_port_t port, uint8_t addr, hd44780_emu_t* emu) {
+    if (port < 0 || port >= I2C_NUM_MAX || s_device_count == FAKE_I2C_MAX_DEVICES) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    s_devices[s_device_count++] = (fake_i2c_device_t){ .port = port, .addr = addr, .emu = emu };
+    return ESP_OK;
+}  // fake_i2c_attach()
+
+// Unplug a device: it stops answering to its address
+void fake_i2c_detach(i2c_port_t port, uint8_t addr) {
+    for (int i = 0; i < s_device_count; i++) {
+        if (s_devices[i].port == port && s_devices[i].addr == addr) {
+            s_devices[i] = s_devices[--s_device_count];
+            return;
+        }
+    }
+}  // fake_i2c_detach()
+
+// Remove all devices and statistics, the virtual clock keeps running
+void fake_i2c_reset(void) {
+    s_device_count = 0;
+    memset(s_stats, 0, sizeof(s_stats));
+}  // fake_i2c_reset()
+
+// Set the SCL frequency of a port
+void fake_i2c_set_clock_hz(i2c_port_t port, uint32_t hz) {
+    s_clock_hz[port] = hz;
+}  // fake_i2c_set_clock_hz()
+
+// Run the earliest esp_timer callback due until the given time, moving the clock to it
+static bool fake_i2c_run_timer(int64_t until_us) {
+    struct esp_timer* next = NULL;
+    for (int i = 0; i < FAKE_I2C_TIMERS; i++) {
+        if (s_timers[i].armed && s_timers[i].due_us <= until_us &&
+            (next == NULL || s_timers[i].due_us < next->due_us)) {
+            next = &s_timers[i];
+        }
+    }
+    if (next == NULL) {
+        return false;
+    }
+    if (next->due_us > s_now_us) {
+        s_now_us = next->due_us;
+    }
+    next->armed = false;
+    next->callback(next->arg);
+    return true;
+}  // fake_i2c_run_timer()
+
+// Move the virtual clock forward, running the esp_timer callbacks that come due in order.
+// Bus traffic of a callback moves the clock as well.
+void fake_i2c_advance_us(int64_t us) {
+    const int64_t until_us = s_now_us + us;
+    while (fake_i2c_run_timer(until_us)) {
+    }
+    if (until_us > s_now_us) {
+        s_now_us = until_us;
+    }
+}  // fake_i2c_advance_us()
+
+// Copy the bus statistics of a port
+void fake_i2c_get_stats(i2c_port_t port, fake_i2c_stats_t* stats) {
+    *stats = s_stats[port];
+}  // fake_i2c_get_stats()
+
+// Find the device that answers to an address byte
+static hd44780_emu_t* fake_i2c_find(i2c_port_t port, uint8_t addr) {
+    for (int i = 0; i < s_device_count; i++) {
+        if (s_devices[i].port == port && s_devices[i].addr == addr) {
+            return s_devices[i].emu;
+        }
+    }
+    return NULL;
+}  // fake_i2c_find()
+
+// Add an operation to a command link
+static esp_err_t fake_i2c_add(i2c_cmd_handle_t cmd_handle, fake_i2c_op_t op) {
+    fake_i2c_link_t* link = (fake_i2c_link_t*)cmd_handle;
+    if (link == NULL || link->count == link->capacity) {
+        return ESP_ERR_NO_MEM;
+    }
+    link->ops[link->count++] = op;
+    return ESP_OK;
+}  // fake_i2c_add()
+
+i2c_cmd_handle_t i2c_cmd_link_create(void) {
+    fake_i2c_link_t* link = malloc(sizeof(fake_i2c_link_t) + FAKE_I2C_LINK_OPS * sizeof(fake_i2c_op_t));
+    if (link != NULL) {
+        *link = (fake_i2c_link_t){ .capacity = FAKE_I2C_LINK_OPS, .allocated = true };
+    }
+    return link;
+}  // i2c_cmd_link_create()
+
+i2c_cmd_handle_t i2c_cmd_link_create_static(uint8_t* buffer, uint32_t size) {
+    if (buffer == NULL || size < sizeof(fake_i2c_link_t) + sizeof(fake_i2c_op_t)) {
+        return NULL;
+    }
+    fake_i2c_link_t* link = (fake_i2c_link_t*)buffer;
+    *link = (fake_i2c_link_t){ .capacity = (size - sizeof(fake_i2c_link_t)) / sizeof(fake_i2c_op_t) };
+    return link;
+}  // i2c_cmd_link_create_static()
+
+void i2c_cmd_link_delete(i2c_cmd_handle_t cmd_handle) {
+    fake_i2c_link_t* link = (fake_i2c_link_t*)cmd_handle;
+    if (link != NULL && link->allocated) {
+        free(link);
+    }
+}  // i2c_cmd_link_delete()
+
+void i2c_cmd_link_delete_static(i2c_cmd_handle_t cmd_handle) {
+    (void)cmd_handle;
+}  // i2c_cmd_link_delete_static()
+
+esp_err_t i2c_master_start(i2c_cmd_handle_t cmd_handle) {
+    return fake_i2c_add(cmd_handle, (fake_i2c_op_t){ .kind = FAKE_I2C_START });
+}  // i2c_master_start()
+
+esp_err_t i2c_master_stop(i2c_cmd_handle_t cmd_handle) {
+    return fake_i2c_add(cmd_handle, (fake_i2c_op_t){ .kind = FAKE_I2C_STOP });
+}  // i2c_master_stop()
+
+esp_err_t i2c_master_write_byte(i2c_cmd_handle_t cmd_handle, uint8_t data, bool ack_en) {
+    (void)ack_en;
+    return fake_i2c_add(cmd_handle, (fake_i2c_op_t){ .kind = FAKE_I2C_WRITE, .byte = data, .len = 1 });
+}  // i2c_master_write_byte()
+
+// Like the real driver the data is not copied: it must stay valid until the link is executed
+esp_err_t i2c_master_write(i2c_cmd_handle_t cmd_handle, const uint8_t* data, size_t data_len, bool ack_en) {
+    (void)ack_en;
+    return fake_i2c_add(cmd_handle, (fake_i2c_op_t){ .kind = FAKE_I2C_WRITE, .data = data, .len = data_len });
+}  // i2c_master_write()
+
+esp_err_t i2c_master_read_byte(i2c_cmd_handle_t cmd_handle, uint8_t* data, i2c_ack_type_t ack) {
+    return i2c_master_read(cmd_handle, data, 1, ack);
+}  // i2c_master_read_byte()
+
+esp_err_t i2c_master_read(i2c_cmd_handle_t cmd_handle, uint8_t* data, size_t data_len, i2c_ack_type_t ack) {
+    (void)ack;
+    return fake_i2c_add(cmd_handle, (fake_i2c_op_t){ .kind = FAKE_I2C_READ, .rx = data, .len = data_len });
+}  // i2c_master_read()
+
+// Replay a command link on the bus. The first byte after a start selects the device and the
+// direction, every byte moves the clock by 9 SCL cycles and reaches the pins at its ACK.
+esp_err_t i2c_master_cmd_begin(i2c_port_t i2c_num, i2c_cmd_handle_t cmd_handle, TickType_t ticks_to_wait) {
+    (void)ticks_to_wait;
+    fake_i2c_link_t* link = (fake_i2c_link_t*)cmd_handle;
+    if (link == NULL || i2c_num < 0 || i2c_num >= I2C_NUM_MAX) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    fake_i2c_stats_t* stats = &s_stats[i2c_num];
+    const int64_t start_us = s_now_us;
+    const uint32_t hz = s_clock_hz[i2c_num];
+    uint64_t cycles = 0;
+    hd44780_emu_t* emu = NULL;
+    bool addressed = false;
+    esp_err_t ret = ESP_OK;
+
+    stats->transactions++;
+    for (size_t i = 0; i < link->count && ret == ESP_OK; i++) {
+        fake_i2c_op_t* op = &link->ops[i];
+        switch (op->kind) {
+        case FAKE_I2C_START:
+        case FAKE_I2C_STOP:
+            cycles += 1;
+            addressed = false;
+            break;
+        case FAKE_I2C_WRITE:
+            for (size_t k = 0; k < op->len && ret == ESP_OK; k++) {
+                uint8_t byte = op->data ? op->data[k] : op->byte;
+                cycles += 9;
+                s_now_us = start_us + (int64_t)(cycles * 1000000 / hz);
+                if (!addressed) {
+                    emu = fake_i2c_find(i2c_num, byte >> 1);
+                    addressed = true;
+                    if (emu == NULL) {
+                        stats->nacks++;
+                        ret = ESP_FAIL;
+                    } else {
+                        hd44780_emu_start(emu);
+                    }
+                } else {
+                    hd44780_emu_write(emu, byte, s_now_us);
+                    stats->bytes_written++;
+                }
+            }
+            break;
+        case FAKE_I2C_READ:
+            for (size_t k = 0; k < op->len; k++) {
+                // The PCF8574 samples its pins at the start of the byte
+                op->rx[k] = hd44780_emu_read(emu, s_now_us);
+                cycles += 9;
+                s_now_us = start_us + (int64_t)(cycles * 1000000 / hz);
+                stats->bytes_read++;
+            }
+            break;
+        }
+    }
+
+    s_now_us = start_us + (int64_t)(cycles * 1000000 / hz);
+    stats->busy_us += s_now_us - start_us;
+    return ret;
+}  // i2c_master_cmd_begin()
+
+int64_t esp_timer_get_time(void) {
+    return s_now_us;
+}  // esp_timer_get_time()
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t* create_args, esp_timer_handle_t* out_handle) {
+    if (create_args == NULL || create_args->callback == NULL || out_handle == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    for (int i = 0; i < FAKE_I2C_TIMERS; i++) {
+        if (!s_timers[i].used) {
+            s_timers[i] = (struct esp_timer){ .callback = create_args->callback, .arg = create_args->arg, .used = true };
+            *out_handle = &s_timers[i];
+            return ESP_OK;
+        }
+    }
+    return ESP_ERR_NO_MEM;
+}  // esp_timer_create()
+
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeout_us) {
+    if (timer == NULL || !timer->used) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (timer->armed) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    timer->armed = true;
+    timer->due_us = s_now_us + (int64_t)timeout_us;
+    return ESP_OK;
+}  // esp_timer_start_once()
+
+esp_err_t esp_timer_stop(esp_timer_handle_t timer) {
+    if (timer == NULL || !timer->armed) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    timer->armed = false;
+    return ESP_OK;
+}  // esp_timer_stop()
+
+esp_err_t esp_timer_delete(esp_timer_handle_t timer) {
+    if (timer == NULL || timer->armed) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    timer->used = false;
+    return ESP_OK;
+}  // esp_timer_delete()
+
+void esp_rom_delay_us(uint32_t us) {
+    s_now_us += us;
+}  // esp_rom_delay_us()
+
+void vTaskDelay(TickType_t ticks) {
+    s_now_us += (int64_t)ticks * portTICK_PERIOD_MS * 1000;
+}  // vTaskDelay()
+
+SemaphoreHandle_t xSemaphoreCreateBinaryStatic(StaticSemaphore_t* buffer) {
+    buffer->count = 0;
+    return buffer;
+}  // xSemaphoreCreateBinaryStatic()
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t sem) {
+    if (sem->count > 0) {
+        return pdFALSE;
+    }
+    sem->count = 1;
+    return pdTRUE;
+}  // xSemaphoreGive()
+
+// Nothing else runs on the host: waiting means running the timers due until the semaphore is given
+BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t ticks) {
+    const int64_t until_us = s_now_us + (int64_t)ticks * portTICK_PERIOD_MS * 1000;
+    while (sem->count == 0 && fake_i2c_run_timer(until_us)) {
+    }
+    if (sem->count == 0) {
+        if (until_us > s_now_us) {
+            s_now_us = until_us;
+        }
+        return pdFALSE;
+    }
+    sem->count = 0;
+    return pdTRUE;
+}  // xSemaphoreTake()
+
+TickType_t xTaskGetTickCount(void) {
+    return s_now_us / (portTICK_PERIOD_MS * 1000);
+}  // xTaskGetTickCount()
@@ -0,0 +1,57 @@
+/// \file fake_i2c.h
+/// \brief Fake I2C bus of the host build with a virtual clock
+///
+/// The legacy command link API of the ESP-IDF I2C driver is replayed on emulated PCF8574 devices.
+/// Every byte takes 9 clock cycles at the bus speed of its port, and the virtual clock behind
+/// esp_timer_get_time(), esp_rom_delay_us() and vTaskDelay() only moves when the bus is busy or
+/// the driver waits, so runs are repeatable and take no real time. One-shot esp_timer callbacks
+/// run from fake_i2c_advance_us().
+///
+/// \author Femi Olugbon, https://iamflinks.github.io
+/// \copyright Copyright (c) 2024 by Femi Olugbon
+///
+/// ChangeLog see: i2c_lcd_pcf8574.h
+
+#pragma once
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "driver/i2c.h"
+#include "hd44780_emu.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define FAKE_I2C_MAX_DEVICES    8
+#define FAKE_I2C_DEFAULT_HZ     100000
+
+typedef struct {
+    uint32_t transactions;
+    uint32_t bytes_written;
+    uint32_t bytes_read;
+    uint32_t nacks;
+    int64_t busy_us;
+} fake_i2c_stats_t;
+
+// Put an emulated display on a port, it answers to the given 7-bit address
+esp_err_t fake_i2c_attach(i2c_port_t port, uint8_t addr, hd44780_emu_t* emu);
+
+// Unplug a device: it stops answering to its address
+void fake_i2c_detach(i2c_port_t port, uint8_t addr);
+
+// Remove all devices and statistics, the virtual clock keeps running
+void fake_i2c_reset(void);
+
+// Set the SCL frequency of a port
+void fake_i2c_set_clock_hz(i2c_port_t port, uint32_t hz);
+
+// Move the virtual clock forward, running the esp_timer callbacks that come due
+void fake_i2c_advance_us(int64_t us);
+
+// Copy the bus statistics of a port
+void fake_i2c_get_stats(i2c_port_t port, fake_i2c_stats_t* stats);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,370 @@
+/// \file hd44780_emu.c
+/// \brief Emulated HD44780 controller behind a PCF8574, MCP23017 or PCA9555 for the host build
+///
+/// \author Femi Olugbon, https://iamflinks.github.io
+/// \copyright Copyright (c) 2024 by Femi Olugbon
+///
+/// ChangeLog see: i2c_lcd_pcf8574.h
+
+#include <string.h>
+#include "hd44780_emu.h"
+
+
+// MCP23017 registers with IOCON.BANK = 0, and the IOCON bit that stops the address increment
+#define MCP23017_IODIRA 0x00
+#define MCP23017_IOCON  0x0A
+#define MCP23017_GPIOA  0x12
+#define MCP23017_OLATA  0x14
+#define MCP23017_REGS   0x16
+#define MCP23017_SEQOP  0x20
+
+// PCA9555 registers
+#define PCA9555_OUTPUT0 0x02
+#define PCA9555_CONFIG0 0x06
+#define PCA9555_REGS    0x08
+
+// Note an access that came too early, only the first one is described
+static void hd44780_emu_violation(hd44780_emu_t* emu, int64_t now_us, const char* what, uint8_t value) {
+    if (emu->violations++ == 0) {
+        snprintf(emu->first_violation, sizeof(emu->first_violation),
+                 "%s 0x%02X at %lld us, %lld us before the controller was ready",
+                 what, value, (long long)now_us, (long long)(emu->busy_until_us - now_us));
+    }
+}  // hd44780_emu_violation()
+
+// Index of a DDRAM address in the ddram array
+static uint8_t hd44780_emu_ddram_index(const hd44780_emu_t* emu, uint8_t addr) {
+    if (emu->two_lines) {
+        return (addr & 0x40 ? 40 : 0) + (addr & 0x3F) % 40;
+    }
+    return addr % HD44780_DDRAM_SIZE;
+}  // hd44780_emu_ddram_index()
+
+// Move the address counter by one: in 2-line mode DDRAM runs 0x00..0x27 and 0x40..0x67
+static void hd44780_emu_step_ac(hd44780_emu_t* emu, bool increment) {
+    if (emu->ac_in_cgram) {
+        emu->ac = (emu->ac + (increment ? 1 : HD44780_CGRAM_SIZE - 1)) % HD44780_CGRAM_SIZE;
+    } else if (emu->two_lines) {
+        if (increment) {
+            emu->ac = emu->ac == 0x27 ? 0x40 : emu->ac == 0x67 ? 0x00 : emu->ac + 1;
+        } else {
+            emu->ac = emu->ac == 0x40 ? 0x27 : emu->ac == 0x00 ? 0x67 : emu->ac - 1;
+        }
+    } else {
+        emu->ac = (emu->ac + (increment ? 1 : HD44780_DDRAM_SIZE - 1)) % HD44780_DDRAM_SIZE;
+    }
+}  // hd44780_emu_step_ac()
+
+// Shift the display window by one position, left moves the text to the left
+static void hd44780_emu_shift_display(hd44780_emu_t* emu, bool left) {
+    uint8_t span = emu->two_lines ? 40 : HD44780_DDRAM_SIZE;
+    emu->shift = (emu->shift + (left ? 1 : span - 1)) % span;
+}  // hd44780_emu_shift_display()
+
+// Execute an instruction (RS low)
+static void hd44780_emu_instruction(hd44780_emu_t* emu, uint8_t value, int64_t now_us) {
+    uint32_t exec_us = HD44780_EXEC_US;
+
+    emu->instructions++;
+    if (value & 0x80) {
+        // Set DDRAM address
+        emu->ac = value & 0x7F;
+        emu->ac_in_cgram = false;
+    } else if (value & 0x40) {
+        // Set CGRAM address
+        emu->ac = value & 0x3F;
+        emu->ac_in_cgram = true;
+    } else if (value & 0x20) {
+        // Function set: the first ones after power on are the reset sequence and take longer
+        if (!emu->four_bit && emu->reset_steps < 2) {
+            exec_us = emu->reset_steps++ == 0 ? HD44780_RESET_1_US : HD44780_RESET_2_US;
+        }
+        emu->four_bit = !(value & 0x10);
+        emu->two_lines = value & 0x08;
+        emu->half = 0;
+    } else if (value & 0x10) {
+        // Cursor or display shift
+        if (value & 0x08) {
+            hd44780_emu_shift_display(emu, !(value & 0x04));
+        } else {
+            hd44780_emu_step_ac(emu, value & 0x04);
+        }
+    } else if (value & 0x08) {
+        // Display control
+        emu->display_on = value & 0x04;
+        emu->cursor_on = value & 0x02;
+        emu->blink_on = value & 0x01;
+    } else if (value & 0x04) {
+        // Entry mode set
+        emu->increment = value & 0x02;
+        emu->shift_on_write = value & 0x01;
+    } else if (value & 0x02) {
+        // Return home
+        emu->ac = 0;
+        emu->ac_in_cgram = false;
+        emu->shift = 0;
+        exec_us = HD44780_CLEAR_US;
+    } else if (value & 0x01) {
+        // Clear display
+        memset(emu->ddram, ' ', sizeof(emu->ddram));
+        emu->ac = 0;
+        emu->ac_in_cgram = false;
+        emu->shift = 0;
+        emu->increment = true;
+        exec_us = HD44780_CLEAR_US;
+    }
+    emu->busy_until_us = now_us + exec_us;
+}  // hd44780_emu_instruction()
+
+// Write data (RS high) to DDRAM or CGRAM at the address counter
+static void hd44780_emu_data(hd44780_emu_t* emu, uint8_t value, int64_t now_us) {
+    emu->data_writes++;
+    if (emu->ac_in_cgram) {
+        emu->cgram[emu->ac] = value & 0x1F;
+    } else {
+        emu->ddram[hd44780_emu_ddram_index(emu, emu->ac)] = value;
+        if (emu->shift_on_write) {
+            hd44780_emu_shift_display(emu, emu->increment);
+        }
+    }
+    hd44780_emu_step_ac(emu, emu->increment);
+    emu->busy_until_us = now_us + HD44780_WRITE_US;
+}  // hd44780_emu_data()
+
+// Value the controller puts on the bus for a read: busy flag and address counter, or RAM data
+static uint8_t hd44780_emu_read_value(const hd44780_emu_t* emu, bool rs, int64_t now_us) {
+    if (rs) {
+        return emu->ac_in_cgram ? emu->cgram[emu->ac] : emu->ddram[hd44780_emu_ddram_index(emu, emu->ac)];
+    }
+    return (now_us < emu->busy_until_us ? 0x80 : 0x00) | (emu->ac & 0x7F);
+}  // hd44780_emu_read_value()
+
+// Levels of D0..D7, lines that are not connected read as low
+static uint8_t hd44780_emu_data_lines(const hd44780_emu_t* emu, uint16_t pins) {
+    uint8_t value = 0;
+    for (int i = 0; i < 8; i++) {
+        if (pins & emu->data_mask[i]) {
+            value |= 1 << i;
+        }
+    }
+    return value;
+}  // hd44780_emu_data_lines()
+
+// E went low: the controller latches what is on the data pins
+static void hd44780_emu_latch(hd44780_emu_t* emu, int64_t now_us) {
+    const bool rs = emu->pins & emu->rs_mask;
+    const uint8_t lines = hd44780_emu_data_lines(emu, emu->pins);
+    const uint8_t nibble = lines >> 4;
+
+    if (emu->pins & emu->rw_mask) {
+        // End of a read cycle: in 4-bit mode the second one returns the low nibble
+        if (!emu->four_bit || ++emu->half == 2) {
+            emu->half = 0;
+            emu->reads++;
+            if (rs) {
+                hd44780_emu_step_ac(emu, emu->increment);
+            }
+        }
+        return;
+    }
+
+    if (!emu->four_bit) {
+        // 8-bit mode: behind a PCF8574 D0..D3 are not connected and read as low
+        if (now_us < emu->busy_until_us) {
+            hd44780_emu_violation(emu, now_us, rs ? "Data" : "Instruction", lines);
+        }
+        if (rs) {
+            hd44780_emu_data(emu, lines, now_us);
+        } else {
+            hd44780_emu_instruction(emu, lines, now_us);
+        }
+        return;
+    }
+
+    if (emu->half == 0) {
+        // A nibble that arrives while the controller is busy is lost, the byte it starts is corrupt
+        if (now_us < emu->busy_until_us) {
+            hd44780_emu_violation(emu, now_us, rs ? "Data nibble" : "Instruction nibble", nibble);
+        }
+        emu->high_nibble = nibble;
+        emu->half = 1;
+        return;
+    }
+
+    uint8_t value = (emu->high_nibble << 4) | nibble;
+    emu->half = 0;
+    if (now_us < emu->busy_until_us) {
+        hd44780_emu_violation(emu, now_us, rs ? "Data" : "Instruction", value);
+    }
+    if (rs) {
+        hd44780_emu_data(emu, value, now_us);
+    } else {
+        hd44780_emu_instruction(emu, value, now_us);
+    }
+}  // hd44780_emu_latch()
+
+// Power the controller on at the given time with the standard PCF8574 backpack wiring
+void hd44780_emu_init(hd44780_emu_t* emu, uint8_t cols, uint8_t rows, int64_t now_us) {
+    memset(emu, 0, sizeof(*emu));
+    hd44780_emu_set_pin_map(emu, 0, 1, 2, 4, 5, 6, 7);
+    emu->cols = cols;
+    emu->rows = rows;
+    emu->increment = true;
+    memset(emu->ddram, ' ', sizeof(emu->ddram));
+    emu->busy_until_us = now_us + HD44780_POWER_ON_US;
+}  // hd44780_emu_init()
+
+// Wire the controller to other PCF8574 pins: P0..P7 as 0..7
+void hd44780_emu_set_pin_map(hd44780_emu_t* emu, uint8_t rs, uint8_t rw, uint8_t enable,
+                             uint8_t d4, uint8_t d5, uint8_t d6, uint8_t d7) {
+    emu->expander = HD44780_EMU_PCF8574;
+    emu->rs_mask = 1 << rs;
+    emu->rw_mask = 1 << rw;
+    emu->enable_mask = 1 << enable;
+    memset(emu->data_mask, 0, sizeof(emu->data_mask));
+    emu->data_mask[4] = 1 << d4;
+    emu->data_mask[5] = 1 << d5;
+    emu->data_mask[6] = 1 << d6;
+    emu->data_mask[7] = 1 << d7;
+}  // hd44780_emu_set_pin_map()
+
+// Put the controller behind a 16-bit expander, as it is after power on
+void hd44780_emu_set_expander(hd44780_emu_t* emu, hd44780_emu_expander_t expander, uint8_t rs, uint8_t rw,
+                              uint8_t enable, const uint8_t data[8]) {
+    emu->expander = expander;
+    emu->rs_mask = 1 << rs;
+    emu->rw_mask = 1 << rw;
+    emu->enable_mask = 1 << enable;
+    for (int i = 0; i < 8; i++) {
+        emu->data_mask[i] = 1 << data[i];
+    }
+    // All pins are inputs, the PCA9555 output latches start high and the MCP23017 ones low
+    emu->input_dir[0] = 0xFF;
+    emu->input_dir[1] = 0xFF;
+    emu->output[0] = expander == HD44780_EMU_PCA9555 ? 0xFF : 0x00;
+    emu->output[1] = emu->output[0];
+    emu->iocon = 0;
+    emu->reg_addressed = false;
+    emu->pins = 0;
+}  // hd44780_emu_set_expander()
+
+// A new transaction: the first byte written is the register pointer
+void hd44780_emu_start(hd44780_emu_t* emu) {
+    emu->reg_addressed = false;
+}  // hd44780_emu_start()
+
+// New levels on the pins the controller is wired to
+static void hd44780_emu_drive(hd44780_emu_t* emu, uint16_t pins, int64_t now_us) {
+    const bool enable_was = emu->pins & emu->enable_mask;
+    const bool enable_is = pins & emu->enable_mask;
+
+    if (!enable_was && enable_is && (pins & emu->rw_mask)) {
+        // Start of a read cycle: the controller drives the data pins while E is high
+        const bool rs = pins & emu->rs_mask;
+        if (!emu->four_bit || emu->half == 0) {
+            emu->read_value = hd44780_emu_read_value(emu, rs, now_us);
+        }
+    }
+    // RS, RW and the data pins are taken from the byte that drops E
+    emu->pins = pins;
+    if (enable_was && !enable_is) {
+        hd44780_emu_latch(emu, now_us);
+    }
+}  // hd44780_emu_drive()
+
+// Write a register of a 16-bit expander and move the register pointer on: the PCA9555 and the
+// MCP23017 with IOCON.SEQOP toggle within the register pair, the MCP23017 without it counts up
+static void hd44780_emu_write_register(hd44780_emu_t* emu, uint8_t value) {
+    const uint8_t port = emu->reg & 0x01;
+
+    if (emu->expander == HD44780_EMU_MCP23017) {
+        if ((emu->reg & ~0x01) == MCP23017_IODIRA) {
+            emu->input_dir[port] = value;
+        } else if ((emu->reg & ~0x01) == MCP23017_IOCON) {
+            emu->iocon = value;
+        } else if ((emu->reg & ~0x01) == MCP23017_GPIOA || (emu->reg & ~0x01) == MCP23017_OLATA) {
+            emu->output[port] = value;
+        }
+        emu->reg = emu->iocon & MCP23017_SEQOP ? emu->reg ^ 0x01 : (emu->reg + 1) % MCP23017_REGS;
+    } else {
+        if ((emu->reg & ~0x01) == PCA9555_OUTPUT0) {
+            emu->output[port] = value;
+        } else if ((emu->reg & ~0x01) == PCA9555_CONFIG0) {
+            emu->input_dir[port] = value;
+        }
+        emu->reg ^= 0x01;
+    }
+}  // hd44780_emu_write_register()
+
+// The expander receives a byte. Pins of a 16-bit expander that are inputs are not driven and read as low.
+void hd44780_emu_write(hd44780_emu_t* emu, uint8_t byte, int64_t now_us) {
+    if (emu->expander == HD44780_EMU_PCF8574) {
+        hd44780_emu_drive(emu, byte, now_us);
+        return;
+    }
+    if (!emu->reg_addressed) {
+        emu->reg = byte % (emu->expander == HD44780_EMU_MCP23017 ? MCP23017_REGS : PCA9555_REGS);
+        emu->reg_addressed = true;
+        return;
+    }
+    hd44780_emu_write_register(emu, byte);
+    const uint16_t pins = (emu->output[0] & ~emu->input_dir[0]) | ((emu->output[1] & ~emu->input_dir[1]) << 8);
+    hd44780_emu_drive(emu, pins, now_us);
+}  // hd44780_emu_write()
+
+// The levels the PCF8574 reads back from its pins. Pins written high are only pulled up weakly,
+// so while a read cycle is running the controller pulls the data pins of its zero bits low.
+uint8_t hd44780_emu_read(const hd44780_emu_t* emu, int64_t now_us) {
+    (void)now_us;
+    uint16_t pins = emu->pins;
+    if ((pins & emu->enable_mask) && (pins & emu->rw_mask)) {
+        uint8_t nibble = emu->four_bit && emu->half == 1 ? emu->read_value & 0x0F : emu->read_value >> 4;
+        for (int i = 0; i < 4; i++) {
+            if (!(nibble & (1 << i))) {
+                pins &= ~emu->data_mask[4 + i];
+            }
+        }
+    }
+    return pins;
+}  // hd44780_emu_read()
+
+// The visible characters of a row, cols bytes plus a terminating zero
+void hd44780_emu_get_row(const hd44780_emu_t* emu, uint8_t row, char* out) {
+    // Rows 2 and 3 of a 4-line display continue the DDRAM lines of rows 0 and 1
+    const uint8_t line = row & 0x01;
+    const uint8_t offset = (row >> 1) * emu->cols;
+
+    for (uint8_t col = 0; col < emu->cols; col++) {
+        if (emu->two_lines) {
+            out[col] = emu->ddram[line * 40 + (offset + emu->shift + col) % 40];
+        } else {
+            out[col] = emu->ddram[(row * emu->cols + emu->shift + col) % HD44780_DDRAM_SIZE];
+        }
+    }
+    out[emu->cols] = '\0';
+}  // hd44780_emu_get_row()
+
+// Print the visible screen, custom characters are shown as their CGRAM slot number
+void hd44780_emu_dump(const hd44780_emu_t* emu, FILE* out) {
+    char row_text[HD44780_DDRAM_SIZE + 1];
+
+    fprintf(out, "+");
+    for (uint8_t col = 0; col < emu->cols; col++) {
+        fputc('-', out);
+    }
+    fprintf(out, "+\n");
+    for (uint8_t row = 0; row < emu->rows; row++) {
+        hd44780_emu_get_row(emu, row, row_text);
+        fputc('|', out);
+        for (uint8_t col = 0; col < emu->cols; col++) {
+            uint8_t c = row_text[col];
+            fputc(!emu->display_on ? ' ' : c < 0x08 ? '0' + c : c < 0x20 || c > 0x7E ? '?' : c, out);
+        }
+        fprintf(out, "|\n");
+    }
+    fprintf(out, "+");
+    for (uint8_t col = 0; col < emu->cols; col++) {
+        fputc('-', out);
+    }
+    fprintf(out, "+\n");
+}  // hd44780_emu_dump()
@@ -0,0 +1,125 @@
+/// \file hd44780_emu.h
+/// \brief Emulated HD44780 controller behind a PCF8574, MCP23017 or PCA9555 for the host build
+///
+/// The emulator sees what the expander drives onto its pins, one byte at a time, and acts on the
+/// falling edges of E like the real controller: 8-bit mode after power on, 4-bit nibble pairs after
+/// the function set, DDRAM, CGRAM, address counter, entry mode and display shift. The 16-bit
+/// expanders are modeled with their registers: register pointer, output latches and pin directions.
+/// Every instruction or data write that arrives before the previous one finished executing is
+/// counted as a timing violation.
+///
+/// \author Femi Olugbon, https://iamflinks.github.io
+/// \copyright Copyright (c) 2024 by Femi Olugbon
+///
+/// ChangeLog see: i2c_lcd_pcf8574.h
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Execution times from the HD44780 datasheet (fosc = 270kHz)
+#define HD44780_POWER_ON_US     40000
+#define HD44780_CLEAR_US        1520
+#define HD44780_EXEC_US         37
+#define HD44780_WRITE_US        41
+#define HD44780_RESET_1_US      4100
+#define HD44780_RESET_2_US      100
+
+#define HD44780_DDRAM_SIZE      80
+#define HD44780_CGRAM_SIZE      64
+
+// Expander in front of the controller
+typedef enum {
+    HD44780_EMU_PCF8574,
+    HD44780_EMU_MCP23017,
+    HD44780_EMU_PCA9555,
+} hd44780_emu_expander_t;
+
+typedef struct {
+    // Expander pins the controller is wired to: P0..P7, or port A/0 in the low and port B/1 in the high byte
+    hd44780_emu_expander_t expander;
+    uint16_t rs_mask;
+    uint16_t rw_mask;
+    uint16_t enable_mask;
+    uint16_t data_mask[8];          // D0..D7, 0 when not connected
+
+    // 16-bit expanders: register pointer, output latches, pin directions (1 = input) and IOCON
+    bool reg_addressed;
+    uint8_t reg;
+    uint8_t output[2];
+    uint8_t input_dir[2];
+    uint8_t iocon;
+
+    // Display geometry, only used to show the visible part of the DDRAM
+    uint8_t cols;
+    uint8_t rows;
+
+    // Levels the expander drives
+    uint16_t pins;
+
+    // Controller state
+    bool four_bit;
+    bool two_lines;
+    bool display_on;
+    bool cursor_on;
+    bool blink_on;
+    bool increment;
+    bool shift_on_write;
+    bool ac_in_cgram;
+    uint8_t ac;
+    uint8_t shift;
+    uint8_t reset_steps;
+    uint8_t half;
+    uint8_t high_nibble;
+    uint8_t read_value;
+    uint8_t ddram[HD44780_DDRAM_SIZE];
+    uint8_t cgram[HD44780_CGRAM_SIZE];
+
+    // Timing
+    int64_t busy_until_us;
+
+    // Counters
+    uint32_t instructions;
+    uint32_t data_writes;
+    uint32_t reads;
+    uint32_t violations;
+    char first_violation[96];
+} hd44780_emu_t;
+
+// Power the controller on at the given time with the standard PCF8574 backpack wiring
+void hd44780_emu_init(hd44780_emu_t* emu, uint8_t cols, uint8_t rows, int64_t now_us);
+
+// Wire the controller to other PCF8574 pins: P0..P7 as 0..7
+void hd44780_emu_set_pin_map(hd44780_emu_t* emu, uint8_t rs, uint8_t rw, uint8_t enable,
+                             uint8_t d4, uint8_t d5, uint8_t d6, uint8_t d7);
+
+// Put the controller behind a 16-bit expander with all 8 data lines wired: pins 0..7 are port A/0,
+// 8..15 port B/1. The expander starts as after power on, all pins inputs.
+void hd44780_emu_set_expander(hd44780_emu_t* emu, hd44780_emu_expander_t expander, uint8_t rs, uint8_t rw,
+                              uint8_t enable, const uint8_t data[8]);
+
+// A new transaction addressed the expander
+void hd44780_emu_start(hd44780_emu_t* emu);
+
+// The expander receives a byte: the PCF8574 drives it onto its pins, the 16-bit expanders take
+// the register pointer first and then write registers
+void hd44780_emu_write(hd44780_emu_t* emu, uint8_t byte, int64_t now_us);
+
+// The levels the PCF8574 reads back from its pins
+uint8_t hd44780_emu_read(const hd44780_emu_t* emu, int64_t now_us);
+
+// The visible characters of a row, cols bytes plus a terminating zero
+void hd44780_emu_get_row(const hd44780_emu_t* emu, uint8_t row, char* out);
+
+// Print the visible screen, custom characters are shown as their CGRAM slot number
+void hd44780_emu_dump(const hd44780_emu_t* emu, FILE* out);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,70 @@
+/// \file idf_stubs.c
+/// \brief ESP-IDF functions the driver needs in the host build, except for the bus and the clock
+///
+/// \author Femi Olugbon, https://iamflinks.github.io
+/// \copyright Copyright (c) 2024 by Femi Olugbon
+///
+/// ChangeLog see: i2c_lcd_pcf8574.h
+
+#include <stdio.h>
+#include <stdarg.h>
+#include "esp_err.h"
+#include "esp_log.h"
+#include "esp_rom_sys.h"
+#include "freertos/task.h"
+
+
+const char* esp_err_to_name(esp_err_t code) {
+    switch (code) {
+    case ESP_OK:                    return "ESP_OK";
+    case ESP_FAIL:                  return "ESP_FAIL";
+    case ESP_ERR_NO_MEM:            return "ESP_ERR_NO_MEM";
+    case ESP_ERR_INVALID_ARG:       return "ESP_ERR_INVALID_ARG";
+    case ESP_ERR_INVALID_STATE:     return "ESP_ERR_INVALID_STATE";
+    case ESP_ERR_INVALID_SIZE:      return "ESP_ERR_INVALID_SIZE";
+    case ESP_ERR_NOT_FOUND:         return "ESP_ERR_NOT_FOUND";
+    case ESP_ERR_NOT_SUPPORTED:     return "ESP_ERR_NOT_SUPPORTED";
+    case ESP_ERR_TIMEOUT:           return "ESP_ERR_TIMEOUT";
+    case ESP_ERR_INVALID_RESPONSE:  return "ESP_ERR_INVALID_RESPONSE";
+    case ESP_ERR_INVALID_CRC:       return "ESP_ERR_INVALID_CRC";
+    case ESP_ERR_INVALID_VERSION:   return "ESP_ERR_INVALID_VERSION";
+    case ESP_ERR_INVALID_MAC:       return "ESP_ERR_INVALID_MAC";
+    case ESP_ERR_NOT_FINISHED:      return "ESP_ERR_NOT_FINISHED";
+    case ESP_ERR_NOT_ALLOWED:       return "ESP_ERR_NOT_ALLOWED";
+    default:                        return "UNKNOWN ERROR";
+    }
+}  // esp_err_to_name()
+
+// Log messages go to stderr until another sink is set
+static int host_log_vprintf(const char* format, va_list args) {
+    return vfprintf(stderr, format, args);
+}  // host_log_vprintf()
+
+static vprintf_like_t s_log_vprintf = host_log_vprintf;
+
+vprintf_like_t esp_log_set_vprintf(vprintf_like_t func) {
+    vprintf_like_t prev = s_log_vprintf;
+    s_log_vprintf = func;
+    return prev;
+}  // esp_log_set_vprintf()
+
+void esp_log_write(esp_log_level_t level, const char* tag, const char* format, ...) {
+    va_list args;
+    va_start(args, format);
+    s_log_vprintf(format, args);
+    va_end(args);
+}  // esp_log_write()
+
+int esp_rom_printf(const char* format, ...) {
+    va_list args;
+    va_start(args, format);
+    int ret = vfprintf(stderr, format, args);
+    va_end(args);
+    return ret;
+}  // esp_rom_printf()
+
+// The host build has one thread: any non-NULL handle will do
+TaskHandle_t xTaskGetCurrentTaskHandle(void) {
+    static int s_task;
+    return &s_task;
+}  // xTaskGetCurrentTaskHandle()
@@ -0,0 +1,87 @@
+/// \file lcd_host_bench.c
+/// \brief Runs the driver benchmark against the emulated display on the fake bus
+///
+/// Usage: lcd_host_bench
+///
+/// The workloads of examples/i2c_lcd_pcf8574_bench on a 20x4 display at 100kHz and 400kHz, one
+/// JSON object per line. All times are virtual: the fake bus clocks every bit and the
+/// controller's execution times, so the numbers repeat exactly from run to run and only change
+/// with the driver. The exit code is 1 if a workload failed or the controller saw a timing
+/// violation.
+///
+/// \author Femi Olugbon, https://iamflinks.github.io
+/// \copyright Copyright (c) 2024 by Femi Olugbon
+///
+/// ChangeLog see: i2c_lcd_pcf8574.h
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "i2c_lcd_pcf8574.h"
+#include "esp_timer.h"
+#include "fake_i2c.h"
+#include "hd44780_emu.h"
+#include "lcd_bench.h"
+
+
+#define LCD_ADDR 0x27
+
+static uint32_t s_allocs;
+
+// Count heap allocations: malloc and friends of the C library are replaced by these
+extern void* __libc_malloc(size_t size);
+extern void* __libc_calloc(size_t count, size_t size);
+extern void* __libc_realloc(void* ptr, size_t size);
+
+void* malloc(size_t size) {
+    s_allocs++;
+    return __libc_malloc(size);
+}  // malloc()
+
+void* calloc(size_t count, size_t size) {
+    s_allocs++;
+    return __libc_calloc(count, size);
+}  // calloc()
+
+void* realloc(void* ptr, size_t size) {
+    s_allocs++;
+    return __libc_realloc(ptr, size);
+}  // realloc()
+
+static uint32_t host_allocs(void) {
+    return s_allocs;
+}  // host_allocs()
+
+int main(int argc, char* argv[]) {
+    static const uint32_t clocks_hz[] = { 100000, 400000 };
+    const lcd_bench_platform_t platform = {
+        .target = "host",
+        .allocs = host_allocs,
+    };
+    int failed = 0;
+
+    // Buffered output would allocate inside the first measurement
+    setvbuf(stdout, NULL, _IOLBF, 0);
+    for (size_t i = 0; i < sizeof(clocks_hz) / sizeof(clocks_hz[0]); i++) {
+        hd44780_emu_t emu;
+        i2c_lcd_pcf8574_handle_t lcd;
+
+        fake_i2c_set_clock_hz(I2C_NUM_0, clocks_hz[i]);
+        hd44780_emu_init(&emu, 20, 4, esp_timer_get_time());
+        fake_i2c_attach(I2C_NUM_0, LCD_ADDR, &emu);
+        lcd_init(&lcd, LCD_ADDR, I2C_NUM_0);
+        if (lcd_begin(&lcd, 20, 4) != ESP_OK) {
+            return 1;
+        }
+        lcd_set_backlight(&lcd, 255);
+
+        lcd_bench_run(&lcd, clocks_hz[i], &platform, stdout);
+
+        if (emu.violations > 0) {
+            fprintf(stderr, "%lu timing violations at %lu Hz, first: %s\n", (unsigned long)emu.violations,
+                    (unsigned long)clocks_hz[i], emu.first_violation);
+            failed++;
+        }
+        fake_i2c_detach(I2C_NUM_0, LCD_ADDR);
+    }
+    return failed > 0 ? 1 : 0;
+}  // main()
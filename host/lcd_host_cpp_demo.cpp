@@ -0,0 +1,103 @@
+/// \file lcd_host_cpp_demo.cpp
+/// \brief Runs the C++ front end against the emulated display on the fake bus
+///
+/// Usage: lcd_host_cpp_demo [SCL frequency in Hz]
+///
+/// Drives a 16x2 display on a backpack with another pin map (RS=P6, RW=P5, E=P4, BL=P7,
+/// D4..D7=P0..P3) through i2c_lcd_pcf8574.hpp: text encoded at compile time, string_view and span
+/// writes, formatted text and the framebuffer after a move. The exit code is 1 when the
+/// controller saw a timing violation or shows something else than expected.
+///
+/// \author Femi Olugbon, https://iamflinks.github.io
+/// \copyright Copyright (c) 2024 by Femi Olugbon
+///
+/// ChangeLog see: i2c_lcd_pcf8574.h
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <utility>
+#include "i2c_lcd_pcf8574.hpp"
+#include "esp_timer.h"
+#include "fake_i2c.h"
+#include "hd44780_emu.h"
+
+
+#define LCD_ADDR 0x3F
+
+namespace lcd = i2c_lcd_pcf8574;
+
+constexpr lcd::pin_map kAltPins{ 0x40, 0x20, 0x10, 0x80, { 0x01, 0x02, 0x04, 0x08 } };
+using display_t = lcd::display<16, 2, kAltPins>;
+
+// Everything below is worked out by the compiler
+static_assert(display_t::row_offsets[1] == 0x40);
+static_assert(display_t::address<3, 1>() == 0x43);
+static_assert(display_t::encode('A')[0] == (0x04 | 0x40 | 0x10));
+constexpr auto kTitle = display_t::encode("C++ front end");
+
+// Compare the emulated screen with the expected rows
+static int check_rows(const hd44780_emu_t* emu, const char* const expected[2]) {
+    char row_text[HD44780_DDRAM_SIZE + 1];
+    int mismatches = 0;
+
+    for (uint8_t row = 0; row < display_t::rows; row++) {
+        hd44780_emu_get_row(emu, row, row_text);
+        if (strncmp(row_text, expected[row], display_t::cols) != 0) {
+            printf("Row %d shows \"%s\", expected \"%s\"\n", row, row_text, expected[row]);
+            mismatches++;
+        }
+    }
+    return mismatches;
+}  // check_rows()
+
+int main(int argc, char* argv[]) {
+    uint32_t clock_hz = argc > 1 ? strtoul(argv[1], NULL, 0) : FAKE_I2C_DEFAULT_HZ;
+    hd44780_emu_t emu;
+    int mismatches = 0;
+
+    fake_i2c_set_clock_hz(I2C_NUM_0, clock_hz);
+    hd44780_emu_init(&emu, display_t::cols, display_t::rows, esp_timer_get_time());
+    hd44780_emu_set_pin_map(&emu, 6, 5, 4, 0, 1, 2, 3);
+    fake_i2c_attach(I2C_NUM_0, LCD_ADDR, &emu);
+
+    display_t first(LCD_ADDR, I2C_NUM_0);
+    if (first.begin() != ESP_OK) {
+        printf("begin() failed\n");
+        return 1;
+    }
+    first.set_backlight(255);
+
+    first.set_cursor<0, 0>();
+    first.write_encoded(kTitle);
+    const uint8_t bytes[] = { 'S', 'p', 'a', 'n' };
+    first.print_at(0, 1, "String view ");
+    first.set_cursor(12, 1);
+    first.write(std::span<const uint8_t>(bytes));
+    const char* const direct[2] = { "C++ front end   ", "String view Span" };
+    mismatches += check_rows(&emu, direct);
+
+    // Positions outside of the display fail instead of being clamped
+    if (first.set_cursor(16, 0) != ESP_ERR_INVALID_ARG) {
+        printf("set_cursor(16, 0) was accepted\n");
+        mismatches++;
+    }
+
+    // The handle moves along with the display
+    display_t lcd_moved = std::move(first);
+    lcd_moved.fb_clear();
+    lcd_moved.fb_print(0, 0, "Moved display");
+    lcd_moved.fb_print(0, 1, "Cut off after sixteen");
+    lcd_moved.flush();
+    lcd_moved.printf_at(10, 0, "%6d", -42);
+    const char* const moved[2] = { "Moved disp   -42", "Cut off after si" };
+    mismatches += check_rows(&emu, moved);
+
+    hd44780_emu_dump(&emu, stdout);
+    printf("Controller: %lu instructions, %lu data writes\n",
+           (unsigned long)emu.instructions, (unsigned long)emu.data_writes);
+    if (emu.violations > 0) {
+        printf("%lu timing violations, first: %s\n", (unsigned long)emu.violations, emu.first_violation);
+    }
+    return emu.violations > 0 || mismatches > 0 ? 1 : 0;
+}  // main()
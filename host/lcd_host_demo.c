@@ -0,0 +1,671 @@
+/// \file lcd_host_demo.c
+/// \brief Runs the driver against the emulated display on the fake bus
+///
+/// Usage: lcd_host_demo [SCL frequency in Hz] [poll|unplug]
+///
+/// Draws through the direct, framebuffer, field and glyph paths, flips pages and runs a marquee
+/// on two more 16x2 displays, drives 16x2 displays in 8-bit mode behind an MCP23017 and a PCA9555,
+/// captures a display's bytes in memory, streams frames through the capture transport and replays
+/// them, checks that frames lost on the way are reported, attaches to a display that stayed powered, sweeps bar graphs and a sparkline, streams
+/// lines to a console, then prints the emulated screens. With "poll" the driver reads the busy
+/// flag instead of waiting, with "unplug" the display is disconnected for a while and has to come
+/// back with its content. The exit code is 1 when a controller saw a timing violation or shows
+/// something else than the framebuffer holds.
+///
+/// \author Femi Olugbon, https://iamflinks.github.io
+/// \copyright Copyright (c) 2024 by Femi Olugbon
+///
+/// ChangeLog see: i2c_lcd_pcf8574.h
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "i2c_lcd_pcf8574.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include "fake_i2c.h"
+#include "hd44780_emu.h"
+
+
+#define LCD_ADDR 0x27
+#define LCD_COLS 20
+#define LCD_ROWS 4
+
+static const uint8_t s_bell[8] = { 0x04, 0x0E, 0x0E, 0x0E, 0x1F, 0x00, 0x04, 0x00 };
+
+// Compare the emulated screen with the framebuffer
+static int check_screen(const hd44780_emu_t* emu, const i2c_lcd_pcf8574_handle_t* lcd) {
+    char row_text[HD44780_DDRAM_SIZE + 1];
+    int mismatches = 0;
+
+    for (uint8_t row = 0; row < lcd->lines; row++) {
+        hd44780_emu_get_row(emu, row, row_text);
+        const uint8_t* expected = &lcd->fb[row * lcd->cols];
+        if (memcmp(row_text, expected, lcd->cols) != 0) {
+            printf("Row %d shows \"%s\", expected \"%.*s\"\n", row, row_text, lcd->cols, (const char*)expected);
+            mismatches++;
+        }
+    }
+    return mismatches;
+}  // check_screen()
+
+// Unplug the display while drawing, then plug in a freshly powered one: the driver has to
+// fail fast, go offline and restore the screen once the display answers again
+static int unplug(hd44780_emu_t* emu, i2c_lcd_pcf8574_handle_t* lcd) {
+    fake_i2c_detach(I2C_NUM_0, LCD_ADDR);
+    int64_t start = esp_timer_get_time();
+    int failed = 0;
+    for (int i = 0; i < 10; i++) {
+        lcd_fb_print(lcd, 0, 2, i % 2 ? "Unplugged   " : "Unplugged!  ");
+        failed += lcd_flush(lcd) != ESP_OK;
+    }
+    printf("Unplugged: %d of 10 flushes failed in %lld us, offline: %s\n", failed,
+           (long long)(esp_timer_get_time() - start), lcd_is_offline(lcd) ? "yes" : "no");
+    if (failed != 10 || !lcd_is_offline(lcd)) {
+        return 1;
+    }
+
+    hd44780_emu_init(emu, LCD_COLS, LCD_ROWS, esp_timer_get_time());
+    fake_i2c_attach(I2C_NUM_0, LCD_ADDR, emu);
+    // The first write after the backoff finds the display and restores it
+    fake_i2c_advance_us(LCD_BREAKER_BACKOFF_MIN_MS * 1000);
+    lcd_fb_print(lcd, 0, 2, "Plugged in  ");
+    esp_err_t ret = lcd_flush(lcd);
+    printf("Plugged in: first flush %s, offline: %s\n", esp_err_to_name(ret), lcd_is_offline(lcd) ? "yes" : "no");
+    return lcd_is_offline(lcd) ? 1 : 0;
+}  // unplug()
+
+// Flip pages on a second, 16x2 display: every screen must appear complete with a single flip
+static int page_flips(void) {
+    static const char* const frames[][2] = {
+        { "Page flipping", "Frame 1" },
+        { "Page flipping", "Frame 2" },
+        { "Off-screen DDRAM", "and display shift" },
+        { "", "Frame 4" },
+    };
+    hd44780_emu_t emu;
+    i2c_lcd_pcf8574_handle_t lcd;
+    int mismatches = 0;
+
+    hd44780_emu_init(&emu, 16, 2, esp_timer_get_time());
+    fake_i2c_attach(I2C_NUM_0, LCD_ADDR - 1, &emu);
+    lcd_init(&lcd, LCD_ADDR - 1, I2C_NUM_0);
+    lcd_begin(&lcd, 16, 2);
+
+    for (size_t i = 0; i < sizeof(frames) / sizeof(frames[0]); i++) {
+        lcd_fb_clear(&lcd);
+        lcd_fb_print(&lcd, 0, 0, frames[i][0]);
+        lcd_fb_print(&lcd, 0, 1, frames[i][1]);
+        if (lcd_page_flip(&lcd) != ESP_OK) {
+            return 1;
+        }
+        mismatches += check_screen(&emu, &lcd);
+    }
+    hd44780_emu_dump(&emu, stdout);
+    printf("Page flips: %u frames, page %u shown\n", (unsigned)(sizeof(frames) / sizeof(frames[0])), lcd.page);
+    if (emu.violations > 0) {
+        printf("%lu timing violations on the 16x2 display, first: %s\n", (unsigned long)emu.violations, emu.first_violation);
+    }
+    fake_i2c_detach(I2C_NUM_0, LCD_ADDR - 1);
+    return emu.violations > 0 || mismatches > 0 ? 1 : 0;
+}  // page_flips()
+
+// Scroll two rows of a 16x2 display: at the same speed the display shift moves them, at different
+// speeds they are redrawn through the framebuffer
+static int marquee(void) {
+    static const char* const ticker = "Marquee: this text fits in DDRAM";
+    static const char* const news = "This one is longer than the 40 characters of a DDRAM line";
+    hd44780_emu_t emu;
+    i2c_lcd_pcf8574_handle_t lcd;
+    lcd_marquee_t marquee;
+    fake_i2c_stats_t before, after;
+    int mismatches = 0;
+
+    hd44780_emu_init(&emu, 16, 2, esp_timer_get_time());
+    fake_i2c_attach(I2C_NUM_0, LCD_ADDR - 2, &emu);
+    lcd_init(&lcd, LCD_ADDR - 2, I2C_NUM_0);
+    lcd_begin(&lcd, 16, 2);
+    if (lcd_marquee_start(&marquee, &lcd) != ESP_OK) {
+        return 1;
+    }
+
+    lcd_marquee_set_text(&marquee, 0, ticker, 250);
+    lcd_marquee_set_text(&marquee, 1, news, 250);
+    fake_i2c_advance_us(0);
+    fake_i2c_get_stats(I2C_NUM_0, &before);
+    for (int i = 0; i < 80; i++) {
+        fake_i2c_advance_us(250000);
+        mismatches += check_screen(&emu, &lcd);
+    }
+    fake_i2c_get_stats(I2C_NUM_0, &after);
+    printf("Marquee, same speed: %lu shift steps, %.1f bytes per step\n", (unsigned long)marquee.shift_steps,
+           (double)(after.bytes_written - before.bytes_written) / 80);
+
+    lcd_marquee_set_text(&marquee, 1, news, 400);
+    fake_i2c_advance_us(0);
+    fake_i2c_get_stats(I2C_NUM_0, &before);
+    uint32_t redraws = marquee.redraw_steps;
+    for (int i = 0; i < 80; i++) {
+        fake_i2c_advance_us(100000);
+        mismatches += check_screen(&emu, &lcd);
+    }
+    fake_i2c_get_stats(I2C_NUM_0, &after);
+    redraws = marquee.redraw_steps - redraws;
+    printf("Marquee, different speeds: %lu redraw steps, %.1f bytes per step\n", (unsigned long)redraws,
+           (double)(after.bytes_written - before.bytes_written) / redraws);
+
+    lcd_marquee_set_text(&marquee, 1, news, 250);
+    fake_i2c_advance_us(1000000);
+    lcd_marquee_stop(&marquee);
+    mismatches += check_screen(&emu, &lcd);
+    hd44780_emu_dump(&emu, stdout);
+    if (emu.violations > 0) {
+        printf("%lu timing violations on the marquee display, first: %s\n", (unsigned long)emu.violations, emu.first_violation);
+    }
+    fake_i2c_detach(I2C_NUM_0, LCD_ADDR - 2);
+    return emu.violations > 0 || mismatches > 0 ? 1 : 0;
+}  // marquee()
+
+// Drive a 16x2 display in 8-bit mode through each 16-bit expander, the MCP23017 one with the
+// data lines wired in reverse order
+static int expanders(void) {
+    static const uint8_t straight[8] = { 0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80 };
+    static const uint8_t reversed[8] = { 0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01 };
+    static const uint8_t emu_straight[8] = { 8, 9, 10, 11, 12, 13, 14, 15 };
+    static const uint8_t emu_reversed[8] = { 15, 14, 13, 12, 11, 10, 9, 8 };
+    static const struct {
+        const char* name;
+        lcd_expander_t expander;
+        hd44780_emu_expander_t emu_expander;
+        uint8_t addr;
+        const uint8_t* data;
+        const uint8_t* emu_data;
+    } setups[] = {
+        { "MCP23017", LCD_EXPANDER_MCP23017, HD44780_EMU_MCP23017, 0x20, reversed, emu_reversed },
+        { "PCA9555", LCD_EXPANDER_PCA9555, HD44780_EMU_PCA9555, 0x21, straight, emu_straight },
+    };
+    int failed = 0;
+
+    for (size_t i = 0; i < sizeof(setups) / sizeof(setups[0]); i++) {
+        hd44780_emu_t emu;
+        i2c_lcd_pcf8574_handle_t lcd;
+        fake_i2c_stats_t before, after;
+
+        hd44780_emu_init(&emu, 16, 2, esp_timer_get_time());
+        hd44780_emu_set_expander(&emu, setups[i].emu_expander, 0, 1, 2, setups[i].emu_data);
+        fake_i2c_attach(I2C_NUM_0, setups[i].addr, &emu);
+        lcd_init(&lcd, setups[i].addr, I2C_NUM_0);
+        lcd_set_expander(&lcd, setups[i].expander, 0x01, 0x02, 0x04, 0x08, setups[i].data);
+        if (lcd_begin(&lcd, 16, 2) != ESP_OK) {
+            return 1;
+        }
+        lcd_set_backlight(&lcd, 255);
+
+        lcd_fb_print(&lcd, 0, 0, setups[i].name);
+        lcd_fb_print(&lcd, 0, 1, "8-bit mode");
+        lcd_fb_put_glyph(&lcd, 15, 0, s_bell);
+        lcd_flush(&lcd);
+        lcd_field_t field;
+        lcd_field_init(&field, 11, 1, 5, 0, LCD_ALIGN_RIGHT);
+        for (int32_t value = 95; value <= 105; value++) {
+            lcd_field_update(&lcd, &field, value);
+        }
+        lcd_fb_print(&lcd, 11, 1, "  105");
+
+        // One line of text: every character is a single E pulse
+        fake_i2c_get_stats(I2C_NUM_0, &before);
+        lcd_set_cursor(&lcd, 0, 1);
+        lcd_print(&lcd, "One pulse a byte");
+        fake_i2c_get_stats(I2C_NUM_0, &after);
+        lcd_fb_print(&lcd, 0, 1, "One pulse a byte");
+
+        const int mismatches = check_screen(&emu, &lcd);
+        hd44780_emu_dump(&emu, stdout);
+        printf("%s: %lu bytes for 16 characters and the cursor\n", setups[i].name,
+               (unsigned long)(after.bytes_written - before.bytes_written));
+        if (emu.violations > 0) {
+            printf("%lu timing violations behind the %s, first: %s\n", (unsigned long)emu.violations,
+                   setups[i].name, emu.first_violation);
+        }
+        fake_i2c_detach(I2C_NUM_0, setups[i].addr);
+        failed += emu.violations > 0 || mismatches > 0;
+    }
+    return failed > 0 ? 1 : 0;
+}  // expanders()
+
+// Collect what the driver sends in memory instead of on the bus and compare it with the
+// expected expander bytes
+static int capture(void) {
+    // "Hi" as data nibbles with RS, E pulses and the backlight: H = 0x48, i = 0x69
+    static const uint8_t expected[] = { 0x4D, 0x49, 0x8D, 0x89, 0x6D, 0x69, 0x9D, 0x99 };
+    uint8_t buf[256];
+    lcd_capture_t cap;
+    lcd_transport_t transport;
+    i2c_lcd_pcf8574_handle_t lcd;
+
+    lcd_init(&lcd, LCD_ADDR, I2C_NUM_0);
+    lcd_transport_capture(&transport, &cap, buf, sizeof(buf));
+    lcd_set_transport(&lcd, &transport);
+    if (lcd_begin(&lcd, 16, 2) != ESP_OK) {
+        return 1;
+    }
+    lcd_set_backlight(&lcd, 255);
+    const size_t start = cap.len;
+    lcd_print(&lcd, "Hi");
+
+    printf("Capture: %lu transactions, %u bytes, %llu us of waits\n", (unsigned long)cap.transactions,
+           (unsigned)cap.len, (unsigned long long)cap.delay_us);
+    if (cap.overflow || cap.len - start != sizeof(expected) || memcmp(&buf[start], expected, sizeof(expected)) != 0) {
+        printf("Captured bytes differ from the expected ones\n");
+        return 1;
+    }
+    return 0;
+}  // capture()
+
+// Completion callback of the streamed frames
+static void stream_done(void* arg, esp_err_t err) {
+    uint32_t* frames = arg;
+    if (err == ESP_OK) {
+        (*frames)++;
+    }
+}  // stream_done()
+
+// Stream two frames into memory through the asynchronous path of the capture transport, then
+// replay the captured bytes on the bus and compare the screen with the framebuffer
+static int stream(void) {
+    static uint8_t buf[2 * LCD_STREAM_FRAME_SIZE];
+    hd44780_emu_t emu;
+    i2c_lcd_pcf8574_handle_t lcd;
+    lcd_capture_t cap;
+    lcd_transport_t capture;
+    lcd_stream_t frames;
+    uint32_t done = 0;
+
+    hd44780_emu_init(&emu, LCD_COLS, LCD_ROWS, esp_timer_get_time());
+    fake_i2c_attach(I2C_NUM_0, 0x26, &emu);
+    lcd_init(&lcd, 0x26, I2C_NUM_0);
+    if (lcd_begin(&lcd, LCD_COLS, LCD_ROWS) != ESP_OK) {
+        return 1;
+    }
+    lcd_set_backlight(&lcd, 255);
+    const lcd_transport_t bus = lcd.transport;
+
+    lcd_transport_capture(&capture, &cap, buf, sizeof(buf));
+    lcd_set_transport(&lcd, &capture);
+    lcd_stream_init(&frames, &lcd, stream_done, &done);
+    lcd_fb_print(&lcd, 0, 0, "Streamed frame 1");
+    lcd_fb_print(&lcd, 0, 3, "Double buffered");
+    lcd_stream_frame(&frames);
+    lcd_fb_print(&lcd, 15, 0, "2");
+    lcd_fb_print(&lcd, 0, 1, "Only changes");
+    lcd_stream_frame(&frames);
+    // Nothing changed: done right away without a frame
+    lcd_stream_frame(&frames);
+    lcd_stream_wait(&frames, 100);
+
+    // Replay both frames on the bus
+    lcd_set_transport(&lcd, &bus);
+    bus.write(bus.ctx, buf, cap.len, lcd.timeout_ms);
+    const int mismatches = check_screen(&emu, &lcd);
+    hd44780_emu_dump(&emu, stdout);
+    printf("Stream: %lu frames done, %u bytes in %lu transactions\n", (unsigned long)done, (unsigned)cap.len,
+           (unsigned long)cap.transactions);
+    fake_i2c_detach(I2C_NUM_0, 0x26);
+    return done != 3 || cap.transactions != 2 || cap.overflow || emu.violations > 0 || mismatches > 0;
+}  // stream()
+
+// Asynchronous transport whose frames all fail on the way
+static esp_err_t stream_fail_async(void* ctx, const uint8_t* bytes, size_t len, uint32_t timeout_ms,
+                                   lcd_transport_done_t done, void* arg) {
+    done(arg, ESP_ERR_TIMEOUT);
+    return ESP_OK;
+}  // stream_fail_async()
+
+// Asynchronous transport that refuses every frame
+static esp_err_t stream_refuse_async(void* ctx, const uint8_t* bytes, size_t len, uint32_t timeout_ms,
+                                     lcd_transport_done_t done, void* arg) {
+    return ESP_ERR_INVALID_STATE;
+}  // stream_refuse_async()
+
+// A frame that fails on the way is reported by the next call, one the transport refuses right
+// away; either way the next frame rewrites the whole screen
+static int stream_failures(void) {
+    static uint8_t buf[4 * LCD_STREAM_FRAME_SIZE];
+    i2c_lcd_pcf8574_handle_t lcd;
+    lcd_capture_t cap;
+    lcd_transport_t transport;
+    lcd_stream_t frames;
+    int failed = 0;
+
+    lcd_init(&lcd, LCD_ADDR, I2C_NUM_0);
+    lcd_transport_capture(&transport, &cap, buf, sizeof(buf));
+    lcd_set_transport(&lcd, &transport);
+    if (lcd_begin(&lcd, LCD_COLS, LCD_ROWS) != ESP_OK) {
+        return 1;
+    }
+    lcd_set_circuit_breaker(&lcd, 0, 100, 100);
+    lcd_stream_init(&frames, &lcd, NULL, NULL);
+
+    const lcd_transport_t working = transport;
+    transport.write_async = stream_fail_async;
+    lcd_set_transport(&lcd, &transport);
+    lcd_fb_print(&lcd, 0, 0, "Lost frame");
+    failed += lcd_stream_frame(&frames) != ESP_OK;
+
+    // The next frame gets through and rewrites every cell, the call reports the lost one
+    lcd_set_transport(&lcd, &working);
+    const size_t start = cap.len;
+    failed += lcd_stream_frame(&frames) != ESP_ERR_TIMEOUT;
+    failed += cap.len - start < 4 * LCD_COLS * LCD_ROWS;
+    failed += lcd_stream_wait(&frames, 100) != ESP_OK;
+
+    // A frame lost last is reported by the wait
+    lcd_set_transport(&lcd, &transport);
+    lcd_fb_print(&lcd, 0, 1, "Lost again");
+    failed += lcd_stream_frame(&frames) != ESP_OK;
+    failed += lcd_stream_wait(&frames, 100) != ESP_ERR_TIMEOUT;
+
+    transport.write_async = stream_refuse_async;
+    lcd_set_transport(&lcd, &transport);
+    lcd_fb_print(&lcd, 0, 2, "Refused");
+    failed += lcd_stream_frame(&frames) != ESP_ERR_INVALID_STATE;
+
+    printf("Stream failures: %lu frames failed, %d unexpected results\n", (unsigned long)frames.frames_failed, failed);
+    return failed > 0 || frames.frames_failed != 2 || cap.overflow;
+}  // stream_failures()
+
+// Start a handle on a display that stayed powered, as after a soft reset: once from a saved
+// state, once from a state that did not survive. Both end with the same screen.
+static int warm(bool poll) {
+    static const uint8_t arrow[8] = { 0x00, 0x04, 0x02, 0x1F, 0x02, 0x04, 0x00, 0x00 };
+    hd44780_emu_t emu;
+    i2c_lcd_pcf8574_handle_t lcd;
+    lcd_warm_state_t state;
+    int failed = 0;
+
+    hd44780_emu_init(&emu, 16, 2, esp_timer_get_time());
+    fake_i2c_attach(I2C_NUM_0, 0x25, &emu);
+    lcd_init(&lcd, 0x25, I2C_NUM_0);
+    lcd_begin(&lcd, 16, 2);
+    lcd_set_backlight(&lcd, 255);
+    if (poll) {
+        lcd_set_busy_polling(&lcd, true);
+    }
+    lcd_fb_print(&lcd, 0, 0, "Before reset");
+    lcd_fb_put_glyph(&lcd, 15, 0, arrow);
+    lcd_fb_print(&lcd, 0, 1, "Temp 21.5");
+    lcd_flush(&lcd);
+    lcd_warm_save(&lcd, &state);
+
+    for (int attempt = 0; attempt < 2; attempt++) {
+        lcd_warm_state_t saved = state;
+        bool is_warm;
+        if (attempt == 1) {
+            // Lost RTC memory
+            saved.ddram[3] ^= 0x01;
+        }
+        const uint32_t instructions = emu.instructions;
+        const uint32_t data_writes = emu.data_writes;
+        const int64_t start = esp_timer_get_time();
+
+        lcd_init(&lcd, 0x25, I2C_NUM_0);
+        if (lcd_begin_warm(&lcd, 16, 2, &saved, &is_warm) != ESP_OK) {
+            return 1;
+        }
+        const int64_t attach_us = esp_timer_get_time() - start;
+        const uint32_t attach_instructions = emu.instructions - instructions;
+        // Redraw everything as after a cold start, only the changes go out
+        lcd_fb_clear(&lcd);
+        lcd_fb_print(&lcd, 0, 0, "After reset");
+        lcd_fb_put_glyph(&lcd, 15, 0, arrow);
+        lcd_fb_print(&lcd, 0, 1, "Temp 21.6");
+        lcd_flush(&lcd);
+        printf("%s start: %lld us, %lu instructions to attach, %lu instructions and %lu data writes in all\n",
+               is_warm ? "Warm" : "Cold", (long long)attach_us, (unsigned long)attach_instructions,
+               (unsigned long)(emu.instructions - instructions), (unsigned long)(emu.data_writes - data_writes));
+        failed += is_warm != (attempt == 0) || check_screen(&emu, &lcd) > 0;
+    }
+    hd44780_emu_dump(&emu, stdout);
+    fake_i2c_detach(I2C_NUM_0, 0x25);
+    return failed > 0 || emu.violations > 0;
+}  // warm()
+
+// Lit pixel columns of a horizontal bar cell on the emulated display
+static int bar_pixels(const hd44780_emu_t* emu, uint8_t code) {
+    if (code == 0xFF) {
+        return 5;
+    }
+    if (code >= 8) {
+        return 0;
+    }
+    return __builtin_popcount(emu->cgram[code * 8]);
+}  // bar_pixels()
+
+// Sweep two horizontal bars, then run a sparkline next to a vertical bar. Every update must
+// show the right number of pixels and only send the cells that change.
+static int widgets(void) {
+    hd44780_emu_t emu;
+    i2c_lcd_pcf8574_handle_t lcd;
+    lcd_bar_t bars[2];
+    lcd_bar_t level;
+    lcd_sparkline_t spark;
+    fake_i2c_stats_t before, after;
+    char row_text[HD44780_DDRAM_SIZE + 1];
+    int failed = 0;
+
+    hd44780_emu_init(&emu, LCD_COLS, LCD_ROWS, esp_timer_get_time());
+    fake_i2c_attach(I2C_NUM_0, 0x24, &emu);
+    lcd_init(&lcd, 0x24, I2C_NUM_0);
+    if (lcd_begin(&lcd, LCD_COLS, LCD_ROWS) != ESP_OK) {
+        return 1;
+    }
+    lcd_bar_init(&bars[0], 0, 0, 16, LCD_BAR_HORIZONTAL, 0, 800);
+    lcd_bar_init(&bars[1], 0, 1, 16, LCD_BAR_HORIZONTAL, 0, 800);
+
+    // 800 samples, one pixel column every 10 of them
+    fake_i2c_get_stats(I2C_NUM_0, &before);
+    for (int32_t value = 0; value <= 800; value++) {
+        lcd_bar_update(&lcd, &bars[0], value);
+        lcd_bar_update(&lcd, &bars[1], 800 - value);
+        if (value % 50 != 0) {
+            continue;
+        }
+        for (uint8_t row = 0; row < 2; row++) {
+            int pixels = 0;
+            hd44780_emu_get_row(&emu, row, row_text);
+            for (uint8_t col = 0; col < 16; col++) {
+                pixels += bar_pixels(&emu, (uint8_t)row_text[col]);
+            }
+            const int expected = (row == 0 ? value : 800 - value) / 10;
+            if (pixels != expected) {
+                printf("Bar %d shows %d pixels at %ld, expected %d\n", row, pixels, (long)value, expected);
+                failed++;
+            }
+        }
+    }
+    fake_i2c_get_stats(I2C_NUM_0, &after);
+    printf("Bars: 1602 updates, %lu bytes in %lu transactions\n", (unsigned long)(after.bytes_written - before.bytes_written),
+           (unsigned long)(after.transactions - before.transactions));
+
+    lcd_clear(&lcd);
+    lcd_fb_clear(&lcd);
+    lcd_sparkline_init(&spark, 0, 0, 16, 3, -100, 100);
+    lcd_bar_init(&level, 19, 3, 4, LCD_BAR_VERTICAL, 0, 32);
+    for (int i = 0; i < 40; i++) {
+        // A triangle wave, steps of 25
+        const int32_t phase = (i * 25) % 400;
+        lcd_sparkline_push(&lcd, &spark, phase < 200 ? phase - 100 : 300 - phase);
+        lcd_bar_update(&lcd, &level, i % 33);
+    }
+    failed += check_screen(&emu, &lcd);
+    for (uint8_t slot = 0; slot < 8; slot++) {
+        if ((lcd.cgram_valid & (1 << slot)) && memcmp(&emu.cgram[slot * 8], lcd.cgram[slot], 8) != 0) {
+            printf("CGRAM slot %d differs\n", slot);
+            failed++;
+        }
+    }
+    hd44780_emu_dump(&emu, stdout);
+    fake_i2c_detach(I2C_NUM_0, 0x24);
+    return failed > 0 || emu.violations > 0;
+}  // widgets()
+
+// Compare the emulated screen with the rows a console should show
+static int check_rows(const hd44780_emu_t* emu, const char* const expected[LCD_ROWS]) {
+    char row_text[HD44780_DDRAM_SIZE + 1];
+    int mismatches = 0;
+
+    for (uint8_t row = 0; row < LCD_ROWS; row++) {
+        char padded[LCD_COLS + 1];
+        snprintf(padded, sizeof(padded), "%-*s", LCD_COLS, expected[row]);
+        hd44780_emu_get_row(emu, row, row_text);
+        if (strncmp(row_text, padded, LCD_COLS) != 0) {
+            printf("Row %d shows \"%s\", expected \"%s\"\n", row, row_text, padded);
+            mismatches++;
+        }
+    }
+    return mismatches;
+}  // check_rows()
+
+// Stream lines to a console on a fifth display: scrolling rewrites only the cells that change,
+// repeats are counted, long lines wrap, log colors are dropped and a rate limit holds back flushes
+static int console(void) {
+    hd44780_emu_t emu;
+    i2c_lcd_pcf8574_handle_t lcd;
+    lcd_console_t con;
+    int failed = 0;
+
+    hd44780_emu_init(&emu, LCD_COLS, LCD_ROWS, esp_timer_get_time());
+    fake_i2c_attach(I2C_NUM_0, 0x23, &emu);
+    lcd_init(&lcd, 0x23, I2C_NUM_0);
+    if (lcd_begin(&lcd, LCD_COLS, LCD_ROWS) != ESP_OK || lcd_console_init(&con, &lcd, true, 0) != ESP_OK) {
+        return 1;
+    }
+
+    lcd_console_write(&con, "boot\nline 2\nline 3\nline 4\nline 5\n", 34);
+    const char* const scrolled[LCD_ROWS] = { "line 2", "line 3", "line 4", "line 5" };
+    failed += check_rows(&emu, scrolled);
+
+    // One more line: every row shows another line, but only the digits differ
+    const uint32_t data_writes = emu.data_writes;
+    lcd_console_printf(&con, "line %d\n", 6);
+    if (emu.data_writes - data_writes != LCD_ROWS) {
+        printf("Scrolling wrote %lu characters, expected %d\n", (unsigned long)(emu.data_writes - data_writes), LCD_ROWS);
+        failed++;
+    }
+
+    for (int i = 0; i < 3; i++) {
+        lcd_console_printf(&con, "tick\n");
+    }
+    lcd_console_printf(&con, "\033[0;32mI (10) app: a long line that wraps\033[0m\n");
+    lcd_console_printf(&con, "partial");
+    const char* const wrapped[LCD_ROWS] = { "tick              x3", "I (10) app: a long l", "ine that wraps", "partial" };
+    failed += check_rows(&emu, wrapped);
+
+    // A burst of lines: the first one is flushed, the rest waits for the poll
+    lcd_console_init(&con, &lcd, true, 100);
+    for (int i = 0; i < 50; i++) {
+        lcd_console_printf(&con, "n %d\n", i);
+    }
+    lcd_console_set_log_sink(&con);
+    ESP_LOGI("app", "sink %d", 1);
+    lcd_console_set_log_sink(NULL);
+    const uint32_t burst_flushes = con.flushes;
+    fake_i2c_advance_us(100000);
+    lcd_console_poll(&con);
+    const char* const burst[LCD_ROWS] = { "n 47", "n 48", "n 49", "I (app) sink 1" };
+    failed += check_rows(&emu, burst);
+    if (burst_flushes != 1) {
+        printf("Burst of 51 lines took %lu flushes, expected 1\n", (unsigned long)burst_flushes);
+        failed++;
+    }
+    printf("Console: %lu lines, %lu collapsed, %lu flushes, %lu held back\n", (unsigned long)con.lines_added,
+           (unsigned long)con.lines_collapsed, (unsigned long)con.flushes, (unsigned long)con.flushes_held);
+
+    hd44780_emu_dump(&emu, stdout);
+    fake_i2c_detach(I2C_NUM_0, 0x23);
+    return failed > 0 || emu.violations > 0;
+}  // console()
+
+int main(int argc, char* argv[]) {
+    uint32_t clock_hz = argc > 1 ? strtoul(argv[1], NULL, 0) : FAKE_I2C_DEFAULT_HZ;
+    hd44780_emu_t emu;
+    i2c_lcd_pcf8574_handle_t lcd;
+    fake_i2c_stats_t stats;
+
+    fake_i2c_set_clock_hz(I2C_NUM_0, clock_hz);
+    hd44780_emu_init(&emu, LCD_COLS, LCD_ROWS, esp_timer_get_time());
+    fake_i2c_attach(I2C_NUM_0, LCD_ADDR, &emu);
+
+    lcd_init(&lcd, LCD_ADDR, I2C_NUM_0);
+    lcd_begin(&lcd, LCD_COLS, LCD_ROWS);
+    lcd_set_backlight(&lcd, 255);
+    if (argc > 2 && strcmp(argv[2], "poll") == 0 && lcd_set_busy_polling(&lcd, true) != ESP_OK) {
+        printf("Busy flag polling failed\n");
+        return 1;
+    }
+
+    // Direct writes
+    lcd_set_cursor(&lcd, 0, 0);
+    lcd_print(&lcd, "Host emulator");
+
+    // Framebuffer: the direct text above is redrawn from the framebuffer
+    lcd_fb_print(&lcd, 0, 0, "Host emulator");
+    lcd_fb_print(&lcd, 0, 1, "SCL:");
+    lcd_fb_put_glyph(&lcd, 19, 0, s_bell);
+    lcd_flush(&lcd);
+
+    char text[LCD_COLS + 1];
+    snprintf(text, sizeof(text), "%lu Hz", (unsigned long)clock_hz);
+    lcd_fb_print(&lcd, 5, 1, text);
+    lcd_flush(&lcd);
+
+    // A field counting up, every update only sends the digits that change
+    lcd_field_t field;
+    lcd_field_init(&field, 0, 3, 8, 2, LCD_ALIGN_RIGHT);
+    for (int32_t value = 995; value <= 1010; value++) {
+        lcd_field_update(&lcd, &field, value);
+    }
+    lcd_fb_print(&lcd, 0, 3, "   10.10");
+    lcd_fb_print(&lcd, 0, 2, "Counter done");
+    lcd_flush(&lcd);
+
+    if (argc > 2 && strcmp(argv[2], "unplug") == 0 && unplug(&emu, &lcd) != 0) {
+        return 1;
+    }
+
+    if (page_flips() != 0 || marquee() != 0 || expanders() != 0 || capture() != 0 || stream() != 0 || stream_failures() != 0 ||
+        warm(argc > 2 && strcmp(argv[2], "poll") == 0) != 0 || widgets() != 0 || console() != 0) {
+        return 1;
+    }
+
+    hd44780_emu_dump(&emu, stdout);
+    fake_i2c_get_stats(I2C_NUM_0, &stats);
+    if (lcd.busy_poll) {
+        uint8_t address = 0;
+        lcd_read_address_counter(&lcd, &address);
+        printf("Address counter 0x%02X, controller 0x%02X\n", address, emu.ac);
+    }
+    printf("Virtual time %lld us, %lu transactions, %lu bytes written, %lu bytes read, bus busy %lld us\n",
+           (long long)esp_timer_get_time(), (unsigned long)stats.transactions, (unsigned long)stats.bytes_written,
+           (unsigned long)stats.bytes_read, (long long)stats.busy_us);
+    printf("Controller: %lu instructions, %lu data writes\n",
+           (unsigned long)emu.instructions, (unsigned long)emu.data_writes);
+
+    lcd_perf_t perf;
+    lcd_perf_get(&lcd, &perf);
+    printf("Driver: %lu transactions, %lu bytes, %lu chars, %lu commands (%lu elided), bus %llu us, spin %llu us, sleep %llu us\n",
+           (unsigned long)perf.transactions, (unsigned long)perf.bytes, (unsigned long)perf.chars,
+           (unsigned long)perf.commands, (unsigned long)perf.elided, (unsigned long long)perf.bus_us, (unsigned long long)perf.delay_us,
+           (unsigned long long)perf.sleep_us);
+    printf("Latency (<64us << i):");
+    for (int i = 0; i < LCD_PERF_LATENCY_BUCKETS; i++) {
+        printf(" %lu", (unsigned long)perf.latency[i]);
+    }
+    printf(", max %lu us, %lu errors\n", (unsigned long)perf.latency_max_us, (unsigned long)perf.errors);
+
+    int mismatches = check_screen(&emu, &lcd);
+    if (emu.violations > 0) {
+        printf("%lu timing violations, first: %s\n", (unsigned long)emu.violations, emu.first_violation);
+    }
+    return emu.violations > 0 || mismatches > 0 ? 1 : 0;
+}  // main()
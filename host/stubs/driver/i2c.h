@@ -0,0 +1,47 @@
+// Host build stand-in for the legacy ESP-IDF I2C driver: the command link is replayed on the fake bus
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+
+typedef int i2c_port_t;
+typedef void* i2c_cmd_handle_t;
+
+#define I2C_NUM_0           0
+#define I2C_NUM_1           1
+#define I2C_NUM_MAX         2
+
+#define I2C_MASTER_WRITE    0
+#define I2C_MASTER_READ     1
+
+typedef enum {
+    I2C_MASTER_ACK,
+    I2C_MASTER_NACK,
+    I2C_MASTER_LAST_NACK,
+} i2c_ack_type_t;
+
+// Room for the fake link's header and the operations of the given number of transactions
+#define I2C_LINK_RECOMMENDED_SIZE(TRANSACTIONS) (2 * sizeof(void*) + (5 * (TRANSACTIONS) + 2) * 4 * sizeof(void*))
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+i2c_cmd_handle_t i2c_cmd_link_create(void);
+i2c_cmd_handle_t i2c_cmd_link_create_static(uint8_t* buffer, uint32_t size);
+void i2c_cmd_link_delete(i2c_cmd_handle_t cmd_handle);
+void i2c_cmd_link_delete_static(i2c_cmd_handle_t cmd_handle);
+esp_err_t i2c_master_start(i2c_cmd_handle_t cmd_handle);
+esp_err_t i2c_master_stop(i2c_cmd_handle_t cmd_handle);
+esp_err_t i2c_master_write_byte(i2c_cmd_handle_t cmd_handle, uint8_t data, bool ack_en);
+esp_err_t i2c_master_write(i2c_cmd_handle_t cmd_handle, const uint8_t* data, size_t data_len, bool ack_en);
+esp_err_t i2c_master_read_byte(i2c_cmd_handle_t cmd_handle, uint8_t* data, i2c_ack_type_t ack);
+esp_err_t i2c_master_read(i2c_cmd_handle_t cmd_handle, uint8_t* data, size_t data_len, i2c_ack_type_t ack);
+esp_err_t i2c_master_cmd_begin(i2c_port_t i2c_num, i2c_cmd_handle_t cmd_handle, TickType_t ticks_to_wait);
+
+#ifdef __cplusplus
+}
+#endif
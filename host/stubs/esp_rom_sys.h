@@ -0,0 +1,16 @@
+// Host build stand-in for the ESP-IDF esp_rom_sys.h: delays advance the virtual clock
+#pragma once
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void esp_rom_delay_us(uint32_t us);
+
+int esp_rom_printf(const char* format, ...);
+
+#ifdef __cplusplus
+}
+#endif
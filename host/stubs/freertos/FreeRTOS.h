@@ -0,0 +1,30 @@
+// Host build stand-in for the FreeRTOS.h of ESP-IDF: single threaded, ticks are virtual
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+
+#define configTICK_RATE_HZ  100
+#define portTICK_PERIOD_MS  (1000 / configTICK_RATE_HZ)
+#define pdMS_TO_TICKS(ms)   ((TickType_t)((ms) * configTICK_RATE_HZ / 1000))
+#define portMAX_DELAY       ((TickType_t)0xffffffffUL)
+#define pdTRUE              1
+#define pdFALSE             0
+#define pdPASS              pdTRUE
+#define pdFAIL              pdFALSE
+#define tskNO_AFFINITY      0x7FFFFFFF
+
+typedef struct {
+    int count;
+} portMUX_TYPE;
+
+#define portMUX_INITIALIZER_UNLOCKED    { 0 }
+#define portMUX_INITIALIZE(mux)         ((mux)->count = 0)
+#define portENTER_CRITICAL(mux)         ((mux)->count++)
+#define portEXIT_CRITICAL(mux)          ((mux)->count--)
+#define portENTER_CRITICAL_SAFE(mux)    portENTER_CRITICAL(mux)
+#define portEXIT_CRITICAL_SAFE(mux)     portEXIT_CRITICAL(mux)
@@ -0,0 +1,6 @@
+// Host build stand-in for the FreeRTOS queue.h of ESP-IDF (types only, the render task is not built)
+#pragma once
+
+#include "freertos/FreeRTOS.h"
+
+typedef void* QueueHandle_t;
@@ -0,0 +1,23 @@
+// Host build stand-in for the FreeRTOS semphr.h of ESP-IDF: binary semaphores only, a take that
+// has to wait runs the esp_timer callbacks of the virtual clock until one gives it
+#pragma once
+
+#include "freertos/FreeRTOS.h"
+
+typedef struct {
+    int count;
+} StaticSemaphore_t;
+
+typedef StaticSemaphore_t* SemaphoreHandle_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+SemaphoreHandle_t xSemaphoreCreateBinaryStatic(StaticSemaphore_t* buffer);
+BaseType_t xSemaphoreGive(SemaphoreHandle_t sem);
+BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t ticks);
+
+#ifdef __cplusplus
+}
+#endif
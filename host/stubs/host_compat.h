@@ -0,0 +1,7 @@
+// Forced include of the host build: newlib functions the driver uses that glibc does not have
+#pragma once
+
+#include <stdio.h>
+#include <stdarg.h>
+
+#define vsniprintf vsnprintf
@@ -0,0 +1,5 @@
+// Host build configuration: all component options at their defaults
+#pragma once
+
+#define CONFIG_LCD_PCF8574_I2C_LEGACY 1
+#define CONFIG_LCD_PCF8574_PERF_COUNTERS 1
@@ -7,24 +7,68 @@
 /// ChangeLog see: i2c_lcd_pcf8574.h
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include "sdkconfig.h"
 #include "i2c_lcd_pcf8574.h"
+#include "i2c_lcd_pcf8574_priv.h"
 #include "esp_log.h"
 #include "esp_check.h"
+#include "esp_timer.h"
+#include "esp_rom_sys.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 
 
 #define TAG "I2C_LCD_PCF8574"
 
-#define I2C_MASTER_TIMEOUT_MS 1000
+// Busy flag polling only pays off for waits longer than a poll (3 short transactions)
+#define LCD_POLL_MIN_US 200
 
+// Waits at least this long give the core back with vTaskDelay() instead of spinning
+#define LCD_YIELD_MIN_US (portTICK_PERIOD_MS * 1000)
+
+// Shorter waits sleep on the wait timer until this long before the deadline and spin the rest,
+// which covers the wake up latency of the esp_timer task
+#define LCD_WAIT_SPIN_US 50
+
+// Longest transaction sent from outside the batch buffer (a character or a register pair)
+#define LCD_TRANSFER_SHORT_MAX 8
+
+
+#if CONFIG_LCD_PCF8574_FIXED_PINMAP
+// Wire bytes of the standard backpack (RS=P0, RW=P1, E=P2, BL=P3, D4..D7=P4..P7), without backlight
+#define LCD_STD_NIBBLE(rs, n) { ((n) << 4) | (rs) | 0x04, ((n) << 4) | (rs) }
+#define LCD_STD_NIBBLES(rs) {                                                                        \
+    LCD_STD_NIBBLE(rs, 0x0), LCD_STD_NIBBLE(rs, 0x1), LCD_STD_NIBBLE(rs, 0x2), LCD_STD_NIBBLE(rs, 0x3), \
+    LCD_STD_NIBBLE(rs, 0x4), LCD_STD_NIBBLE(rs, 0x5), LCD_STD_NIBBLE(rs, 0x6), LCD_STD_NIBBLE(rs, 0x7), \
+    LCD_STD_NIBBLE(rs, 0x8), LCD_STD_NIBBLE(rs, 0x9), LCD_STD_NIBBLE(rs, 0xA), LCD_STD_NIBBLE(rs, 0xB), \
+    LCD_STD_NIBBLE(rs, 0xC), LCD_STD_NIBBLE(rs, 0xD), LCD_STD_NIBBLE(rs, 0xE), LCD_STD_NIBBLE(rs, 0xF), \
+}
+static const uint8_t s_std_lut[2][16][2] = { LCD_STD_NIBBLES(0x00), LCD_STD_NIBBLES(0x01) };
+#define LCD_LUT(lcd) s_std_lut
+#define LCD_BACKLIGHT_BITS(lcd) ((lcd)->backlight > 0 ? 0x08 : 0x00)
+#else
+#define LCD_LUT(lcd) ((lcd)->nibble_lut)
+#define LCD_BACKLIGHT_BITS(lcd) ((lcd)->backlight > 0 ? (lcd)->backlight_mask : 0x00)
+#endif
 
 // private functions
-static void lcd_send(i2c_lcd_pcf8574_handle_t* lcd, uint8_t value, bool is_data);
-static void lcd_write_nibble(i2c_lcd_pcf8574_handle_t* lcd, uint8_t half_byte, bool is_data, i2c_cmd_handle_t cmd);
+static void lcd_send_nibble(i2c_lcd_pcf8574_handle_t* lcd, uint8_t half_byte);
+static void lcd_track(i2c_lcd_pcf8574_handle_t* lcd, uint8_t value, bool is_data);
+static void lcd_build_lut(i2c_lcd_pcf8574_handle_t* lcd);
 static void lcd_write_i2c(i2c_lcd_pcf8574_handle_t* lcd, uint8_t data, bool is_data, bool enable);
+static void lcd_queue(i2c_lcd_pcf8574_handle_t* lcd, const uint8_t* bytes, size_t len);
+static esp_err_t lcd_transfer(i2c_lcd_pcf8574_handle_t* lcd, const uint8_t* bytes, size_t len, uint8_t* rx, size_t rx_len);
+static esp_err_t lcd_read_busy(i2c_lcd_pcf8574_handle_t* lcd, uint8_t* value);
+static bool lcd_default_pin_map(const i2c_lcd_pcf8574_handle_t* lcd);
+static esp_err_t lcd_busy_probe(i2c_lcd_pcf8574_handle_t* lcd);
+static void lcd_breaker_probe(i2c_lcd_pcf8574_handle_t* lcd);
+static void lcd_recover(i2c_lcd_pcf8574_handle_t* lcd);
 
-void lcd_init(i2c_lcd_pcf8574_handle_t* lcd, uint8_t i2c_addr, i2c_port_t i2c_port) {
+esp_err_t lcd_init(i2c_lcd_pcf8574_handle_t* lcd, uint8_t i2c_addr, i2c_port_t i2c_port) {
+    ESP_RETURN_ON_FALSE(lcd != NULL && i2c_addr < 0x80, ESP_ERR_INVALID_ARG, TAG, "Invalid LCD handle or address");
     lcd->i2c_addr = i2c_addr;
     lcd->i2c_port = i2c_port;
     lcd->backlight = 0;
@@ -38,93 +82,164 @@ void lcd_init(i2c_lcd_pcf8574_handle_t* lcd, uint8_t i2c_addr, i2c_port_t i2c_po
     lcd->data_mask[2] = 0x40;
     lcd->data_mask[3] = 0x80;
     lcd->backlight_mask = 0x08;
+    lcd->expander = LCD_EXPANDER_PCF8574;
+    lcd->expander_reg = 0;
+#if CONFIG_LCD_PCF8574_I2C_LEGACY
+    lcd_transport_legacy(&lcd->transport, &lcd->legacy, i2c_port, i2c_addr);
+#else
+    // The I2C master driver needs a device handle, see lcd_transport_i2c_master()
+    memset(&lcd->transport, 0, sizeof(lcd->transport));
+#endif
+    lcd_build_lut(lcd);
+    lcd->batch_depth = 0;
+    lcd->batch_len = 0;
+    lcd->page = 0;
+    lcd->page_lost = false;
+    lcd_ddram_invalidate(lcd);
+    lcd_forget_state(lcd);
+    lcd->ready_at_us = 0;
+    lcd->busy_poll = false;
+    lcd->wait_timer = NULL;
+    lcd->wait_sem = xSemaphoreCreateBinaryStatic(&lcd->wait_sem_buf);
+    lcd->wait_spin = false;
+    lcd->cgram_valid = 0;
+    lcd->cgram_clock = 0;
+    memset(lcd->cgram_used, 0, sizeof(lcd->cgram_used));
+    lcd->ring = NULL;
+    lcd->render_task = NULL;
+    lcd->render_queue = NULL;
+    lcd->render_queue_len = 0;
+    lcd->render_queued = 0;
+    lcd->render_stopping = false;
+    lcd->render_posting = 0;
+    lcd->render_running = false;
+    portMUX_INITIALIZE(&lcd->render_lock);
+    memset(&lcd->render_stats, 0, sizeof(lcd->render_stats));
+#if CONFIG_LCD_PCF8574_PERF_COUNTERS
+    portMUX_INITIALIZE(&lcd->perf_lock);
+    memset(&lcd->perf, 0, sizeof(lcd->perf));
+#endif
+#if CONFIG_LCD_PCF8574_ASSERT_NO_ALLOC
+    lcd->no_alloc = false;
+    portMUX_INITIALIZE(&lcd->no_alloc_lock);
+    memset((void*)lcd->no_alloc_task, 0, sizeof(lcd->no_alloc_task));
+    memset(lcd->no_alloc_depth, 0, sizeof(lcd->no_alloc_depth));
+#endif
+    lcd->timeout_ms = LCD_DEFAULT_TIMEOUT_MS;
+    lcd->bus_err = ESP_OK;
+    lcd->failures = 0;
+    lcd->breaker_threshold = LCD_BREAKER_THRESHOLD;
+    lcd->breaker_open = false;
+    lcd->recover_pending = false;
+    lcd->backoff_min_ms = LCD_BREAKER_BACKOFF_MIN_MS;
+    lcd->backoff_max_ms = LCD_BREAKER_BACKOFF_MAX_MS;
+    lcd->backoff_ms = 0;
+    lcd->probe_at_us = 0;
+    return ESP_OK;
 }   // lcd_begin()
 
-void lcd_begin(i2c_lcd_pcf8574_handle_t* lcd, uint8_t cols, uint8_t rows) {
-
-    // Ensure the cols and rows stay within max limit
-    lcd->cols = (cols > 80) ? 80 : cols;
-    lcd->lines = (rows > 4) ? 4 : rows;
+esp_err_t lcd_begin(i2c_lcd_pcf8574_handle_t* lcd, uint8_t cols, uint8_t rows) {
+    LCD_NO_ALLOC_SCOPE(lcd);
+    ESP_RETURN_ON_FALSE(LCD_GEOMETRY_VALID(cols, rows), ESP_ERR_INVALID_ARG, TAG,
+                        "The controller can't address a %dx%d display", cols, rows);
+    ESP_RETURN_ON_FALSE(lcd->transport.write != NULL, ESP_ERR_INVALID_STATE, TAG, "No transport, see lcd_set_transport()");
+    ESP_RETURN_ON_ERROR(lcd_wait_setup(lcd), TAG, "Failed to create the wait timer");
+    lcd->cols = cols;
+    lcd->lines = rows;
 
     lcd->row_offsets[0] = 0x00;
     lcd->row_offsets[1] = 0x40;
     lcd->row_offsets[2] = 0x00 + cols;
     lcd->row_offsets[3] = 0x40 + cols;
+    lcd->page = 0;
 
-    // Initialize the LCD
+    // The busy flag can't be read before the controller is in 4-bit mode
+    bool busy_poll = lcd->busy_poll;
+    lcd->busy_poll = false;
+
+    // The lcd_clear() below leaves spaces everywhere, start the framebuffer the same way
+    memset(lcd->fb, ' ', sizeof(lcd->fb));
+
+    // Initialize the LCD: it needs more than 40ms after power on before it takes instructions
+    if (LCD_EXPANDER_8BIT(lcd)) {
+        lcd_expander_setup(lcd);
+    }
     lcd_write_i2c(lcd, 0x00, false, false);
-    esp_rom_delay_us(50000);
+    lcd_set_busy(lcd, 50000);
 
     // This follows after the reset mode
     lcd->displaycontrol = 0x04;
     lcd->entrymode = 0x02;
 
-    // The following are the reset sequence: Please see "Initialization instruction in the PCF8574 datasheet."
-    i2c_cmd_handle_t cmd = i2c_cmd_link_create();
-    i2c_master_start(cmd);
-    // We left-shift the device addres and add the read/write command
-    i2c_master_write_byte(cmd, (lcd->i2c_addr << 1) | I2C_MASTER_WRITE, true);
-    
-    lcd_write_nibble(lcd, 0x03, false, cmd);
-    i2c_master_stop(cmd);
-    i2c_master_cmd_begin(lcd->i2c_port, cmd, I2C_MASTER_TIMEOUT_MS / portTICK_PERIOD_MS);
-    i2c_cmd_link_delete(cmd);
-    esp_rom_delay_us(4500);
-
-    cmd = i2c_cmd_link_create();
-    i2c_master_start(cmd);
-    i2c_master_write_byte(cmd, (lcd->i2c_addr << 1) | I2C_MASTER_WRITE, true);
-    lcd_write_nibble(lcd, 0x03, false, cmd);
-    i2c_master_stop(cmd);
-    i2c_master_cmd_begin(lcd->i2c_port, cmd, I2C_MASTER_TIMEOUT_MS / portTICK_PERIOD_MS);
-    i2c_cmd_link_delete(cmd);
-    esp_rom_delay_us(200);
-
-    cmd = i2c_cmd_link_create();
-    i2c_master_start(cmd);
-    i2c_master_write_byte(cmd, (lcd->i2c_addr << 1) | I2C_MASTER_WRITE, true);
-    lcd_write_nibble(lcd, 0x03, false, cmd);
-    i2c_master_stop(cmd);
-    i2c_master_cmd_begin(lcd->i2c_port, cmd, I2C_MASTER_TIMEOUT_MS / portTICK_PERIOD_MS);
-    i2c_cmd_link_delete(cmd);
-    esp_rom_delay_us(200);
-
-    // Set the data interface to 4-bit interface (PCF8574 uses 4-bit interface)
-    cmd = i2c_cmd_link_create();
-    i2c_master_start(cmd);
-    i2c_master_write_byte(cmd, (lcd->i2c_addr << 1) | I2C_MASTER_WRITE, true);
-    lcd_write_nibble(lcd, 0x02, false, cmd);
-    i2c_master_stop(cmd);
-    i2c_master_cmd_begin(lcd->i2c_port, cmd, I2C_MASTER_TIMEOUT_MS / portTICK_PERIOD_MS);
-    i2c_cmd_link_delete(cmd);
-
-    // Instruction: function set = 0x20
-    lcd_send(lcd, 0x20 | (rows > 1 ? 0x08 : 0x00), false);
+    if (LCD_EXPANDER_8BIT(lcd)) {
+        // 8-bit interface: the reset sequence with whole bytes, the interface stays 8 bits wide
+        lcd_send(lcd, 0x30, false);
+        lcd_set_busy(lcd, 4500);
+        lcd_send(lcd, 0x30, false);
+        lcd_set_busy(lcd, 200);
+        lcd_send(lcd, 0x30, false);
+        lcd_set_busy(lcd, 200);
+    } else {
+        // The following are the reset sequence: Please see "Initialization instruction in the PCF8574 datasheet."
+        // Each nibble waits for the deadline set by the step before it.
+        lcd_send_nibble(lcd, 0x03);
+        lcd_set_busy(lcd, 4500);
+
+        lcd_send_nibble(lcd, 0x03);
+        lcd_set_busy(lcd, 200);
+
+        lcd_send_nibble(lcd, 0x03);
+        lcd_set_busy(lcd, 200);
+
+        // Set the data interface to 4-bit interface (PCF8574 uses 4-bit interface)
+        lcd_send_nibble(lcd, 0x02);
+    }
+
+    // Instruction: function set = 0x20, 8-bit interface = 0x10, 2 lines = 0x08
+    lcd_send(lcd, 0x20 | (LCD_EXPANDER_8BIT(lcd) ? 0x10 : 0x00) | (rows > 1 ? 0x08 : 0x00), false);
+    lcd->busy_poll = busy_poll;
+    LCD_RETURN_ON_ERROR(lcd_finish(lcd));
 
     // Set the display parameters (turn on display, clear, and set left to right)
-    lcd_display(lcd);
-    lcd_clear(lcd);
-    lcd_left_to_right(lcd);
+    LCD_RETURN_ON_ERROR(lcd_display(lcd));
+    LCD_RETURN_ON_ERROR(lcd_clear(lcd));
+    LCD_RETURN_ON_ERROR(lcd_left_to_right(lcd));
+    LCD_NO_ALLOC_ARM(lcd);
+    return ESP_OK;
 }  // lcd_begin()
 
 // Clear the display content
-void lcd_clear(i2c_lcd_pcf8574_handle_t* lcd) {
+esp_err_t lcd_clear(i2c_lcd_pcf8574_handle_t* lcd) {
+    LCD_NO_ALLOC_SCOPE(lcd);
     // Instruction: Clear display = 0x01
     lcd_send(lcd, 0x01, false);
-    // Clearing the display takes a while: takes approx. 1.5ms
-    esp_rom_delay_us(1600);
+    // Anything batched after this must wait for the clear, so send what we have now
+    lcd_batch_flush(lcd);
+    // The whole DDRAM is now filled with spaces and the display shift is back to 0
+    lcd_page_reset(lcd);
+    memset(lcd->ddram, ' ', sizeof(lcd->ddram));
+    lcd->ddram_valid = true;
+    lcd->page_stale = false;
+    // Clearing the display takes a while: takes approx. 1.5ms. Only the next bus access waits for it.
+    lcd_set_busy(lcd, 1600);
+    return lcd_finish(lcd);
 }  // lcd_clear()
 
 // Set the display to home
-void lcd_home(i2c_lcd_pcf8574_handle_t* lcd) {
+esp_err_t lcd_home(i2c_lcd_pcf8574_handle_t* lcd) {
+    LCD_NO_ALLOC_SCOPE(lcd);
     // Instruction: Return home = 0x02
     lcd_send(lcd, 0x02, false);
+    lcd_batch_flush(lcd);
+    lcd_page_reset(lcd);
     // Same as clearing the display: takes approx. 1.5ms
-    esp_rom_delay_us(1600);
+    lcd_set_busy(lcd, 1600);
+    return lcd_finish(lcd);
 }  // lcd_home()
 
 // Set the cursor to a new position.
-void lcd_set_cursor(i2c_lcd_pcf8574_handle_t* lcd, uint8_t col, uint8_t row) {
+esp_err_t lcd_set_cursor(i2c_lcd_pcf8574_handle_t* lcd, uint8_t col, uint8_t row) {
+    LCD_NO_ALLOC_SCOPE(lcd);
     // Check the display boundaries
     if (row >= lcd->lines) {
         row = lcd->lines - 1;
@@ -132,141 +247,174 @@ void lcd_set_cursor(i2c_lcd_pcf8574_handle_t* lcd, uint8_t col, uint8_t row) {
     if (col >= lcd->cols) {
         col = lcd->cols - 1;
     }
-    // Instruction: Set DDRAM address = 080
-    lcd_send(lcd, 0x80 | (lcd->row_offsets[row] + col), false);
+    lcd_set_address(lcd, lcd->row_offsets[row] + col);
+    return lcd_finish(lcd);
 }  // lcd_set_cursor()
 
 // Turn off the display: fast operation
-void lcd_no_display(i2c_lcd_pcf8574_handle_t* lcd) {
+esp_err_t lcd_no_display(i2c_lcd_pcf8574_handle_t* lcd) {
+    LCD_NO_ALLOC_SCOPE(lcd);
     // Display Control: Display on/off control = 0x04
     lcd->displaycontrol &= ~0x04;
-    // Instruction: Display mode: 0x08
-    lcd_send(lcd, 0x08 | lcd->displaycontrol, false);
+    lcd_send_displaycontrol(lcd);
+    return lcd_finish(lcd);
 }  // lcd_no_display()
 
 // Turn on the display: fast operation
-void lcd_display(i2c_lcd_pcf8574_handle_t* lcd) {
+esp_err_t lcd_display(i2c_lcd_pcf8574_handle_t* lcd) {
+    LCD_NO_ALLOC_SCOPE(lcd);
     // Display Control: Display on/off control = 0x04
     lcd->displaycontrol |= 0x04;
-    // Instruction: Display mode: 0x08
-    lcd_send(lcd, 0x08 | lcd->displaycontrol, false);
+    lcd_send_displaycontrol(lcd);
+    return lcd_finish(lcd);
 }  // lcd_display()
 
 // Turn on the cursor
-void lcd_cursor(i2c_lcd_pcf8574_handle_t* lcd) {
+esp_err_t lcd_cursor(i2c_lcd_pcf8574_handle_t* lcd) {
+    LCD_NO_ALLOC_SCOPE(lcd);
     // Display Control: Cursor on/off control = 0x02
     lcd->displaycontrol |= 0x02;
-    // Instruction: Display mode: 0x08
-    lcd_send(lcd, 0x08 | lcd->displaycontrol, false);
+    lcd_send_displaycontrol(lcd);
+    return lcd_finish(lcd);
 }  // lcd_cursor()
 
 // Turn off the cursor
-void lcd_no_cursor(i2c_lcd_pcf8574_handle_t* lcd) {
+esp_err_t lcd_no_cursor(i2c_lcd_pcf8574_handle_t* lcd) {
+    LCD_NO_ALLOC_SCOPE(lcd);
     // Display Control: Cursor on/off control = 0x02
     lcd->displaycontrol &= ~0x02;
-    // Instruction: Display mode: 0x08
-    lcd_send(lcd, 0x08 | lcd->displaycontrol, false);
+    lcd_send_displaycontrol(lcd);
+    return lcd_finish(lcd);
 }  // lcd_no_cursor()
 
 // Turn on the blinking
-void lcd_blink(i2c_lcd_pcf8574_handle_t* lcd) {
+esp_err_t lcd_blink(i2c_lcd_pcf8574_handle_t* lcd) {
+    LCD_NO_ALLOC_SCOPE(lcd);
     // Display Control: Blink on/off control = 0x01
     lcd->displaycontrol |= 0x01;
-    // Instruction: Display mode: 0x08
-    lcd_send(lcd, 0x08 | lcd->displaycontrol, false);
+    lcd_send_displaycontrol(lcd);
+    return lcd_finish(lcd);
 }  // lcd_blink()
 
 // Turn off the blinking
-void lcd_no_blink(i2c_lcd_pcf8574_handle_t* lcd) {
+esp_err_t lcd_no_blink(i2c_lcd_pcf8574_handle_t* lcd) {
+    LCD_NO_ALLOC_SCOPE(lcd);
     // Display Control: Blink on/off control = 0x01
     lcd->displaycontrol &= ~0x01;
-    // Instruction: Display mode: 0x08
-    lcd_send(lcd, 0x08 | lcd->displaycontrol, false);
+    lcd_send_displaycontrol(lcd);
+    return lcd_finish(lcd);
 }  // lcd_no_blink()
 
 // This command will scroll the display left by one step without changing the RAM
-void lcd_scroll_display_left(i2c_lcd_pcf8574_handle_t* lcd) {
+esp_err_t lcd_scroll_display_left(i2c_lcd_pcf8574_handle_t* lcd) {
+    LCD_NO_ALLOC_SCOPE(lcd);
     // Instruction: Cursor or display shift - 0x10
     // Instruction: Display mode: 0x08
     // Control: Left shift control = 0x00
     // 0x10 | 0x08 | 0x00 = 0x18
     lcd_send(lcd, 0x18, false);
+    return lcd_finish(lcd);
 }  // lcd_scroll_display_left()
 
 // This command will scroll the display right by one step without changing the RAM
-void lcd_scroll_display_right(i2c_lcd_pcf8574_handle_t* lcd) {
+esp_err_t lcd_scroll_display_right(i2c_lcd_pcf8574_handle_t* lcd) {
+    LCD_NO_ALLOC_SCOPE(lcd);
     // Instruction: Cursor or display shift - 0x10
     // Instruction: Display mode: 0x08
     // Control: Left shift control = 0x04
     // 0x10 | 0x08 | 0x04 = 0x1C
     lcd_send(lcd, 0x1C, false);
+    return lcd_finish(lcd);
 }  // lcd_scroll_display_right()
 
 // Controlling the entry mode: This is for text that flows left to right
-void lcd_left_to_right(i2c_lcd_pcf8574_handle_t* lcd) {
+esp_err_t lcd_left_to_right(i2c_lcd_pcf8574_handle_t* lcd) {
+    LCD_NO_ALLOC_SCOPE(lcd);
     // Instruction: Entry mode set, set increment/decrement = 0x02
     lcd->entrymode |= 0x02;
-    lcd_send(lcd, 0x04 | lcd->entrymode, false);
+    lcd_send_entrymode(lcd);
+    return lcd_finish(lcd);
 }  // lcd_left_to_right()
 
 // Controlling the entry mode: This is for text that flows right to left
-void lcd_right_to_left(i2c_lcd_pcf8574_handle_t* lcd) {
+esp_err_t lcd_right_to_left(i2c_lcd_pcf8574_handle_t* lcd) {
+    LCD_NO_ALLOC_SCOPE(lcd);
     // Instruction: Entry mode set, clear increment/decrement = 0x02
     lcd->entrymode &= ~0x02;
-    lcd_send(lcd, 0x04 | lcd->entrymode, false);
+    lcd_send_entrymode(lcd);
+    return lcd_finish(lcd);
 }  // lcd_right_to_left()
 
 // This will justify the text to the right from the cursor
-void lcd_autoscroll(i2c_lcd_pcf8574_handle_t* lcd) {
+esp_err_t lcd_autoscroll(i2c_lcd_pcf8574_handle_t* lcd) {
+    LCD_NO_ALLOC_SCOPE(lcd);
     // Instruction: Entry mode set, set shift = 0x01
     lcd->entrymode |= 0x01;
-    lcd_send(lcd, 0x04 | lcd->entrymode, false);
+    lcd_send_entrymode(lcd);
+    return lcd_finish(lcd);
 }  // lcd_autoscroll()
 
 // This will justify the text to the left from the cursor
-void lcd_no_autoscroll(i2c_lcd_pcf8574_handle_t* lcd) {
+esp_err_t lcd_no_autoscroll(i2c_lcd_pcf8574_handle_t* lcd) {
+    LCD_NO_ALLOC_SCOPE(lcd);
     // Instruction: Entry mode set, clear shift = 0x01
     lcd->entrymode &= ~0x01;
-    lcd_send(lcd, 0x04 | lcd->entrymode, false);
+    lcd_send_entrymode(lcd);
+    return lcd_finish(lcd);
 }  // lcd_no_autoscroll()
 
 // Setting the backlight: It can only be turn on or off.
 // Current backlight value is saved in the i2c_lcd_pcf8574_handle_t struct for further data transfers
-void lcd_set_backlight(i2c_lcd_pcf8574_handle_t* lcd, uint8_t brightness) {
+esp_err_t lcd_set_backlight(i2c_lcd_pcf8574_handle_t* lcd, uint8_t brightness) {
+    LCD_NO_ALLOC_SCOPE(lcd);
     // Place the backlight value in the lcd struct
     lcd->backlight = brightness;
     // Send no data
     lcd_write_i2c(lcd, 0x00, true, false);
+    return lcd_finish(lcd);
 }  // lcd_set_backlight()
 
 // Custom character creation: allows us to create up to 8 custom characters in the CGRAM locations
-void lcd_create_char(i2c_lcd_pcf8574_handle_t* lcd, uint8_t location, uint8_t charmap[]) {
+esp_err_t lcd_create_char(i2c_lcd_pcf8574_handle_t* lcd, uint8_t location, uint8_t charmap[]) {
+    LCD_NO_ALLOC_SCOPE(lcd);
     location &= 0x7;  // Only 8 locations are available
+    lcd_batch_begin(lcd);
     // Set the CGRAM address
     lcd_send(lcd, 0x40 | (location << 3), false);
     for (int i = 0; i < 8; i++) {
-        lcd_write(lcd, charmap[i]);
+        lcd_send(lcd, charmap[i], true);
     }
+    esp_err_t ret = lcd_batch_commit(lcd);
+    // Let the glyph cache know what the slot holds now. After a failure the slot content is
+    // unknown, but it is kept as wanted content so a recovered display gets it again.
+    memcpy(lcd->cgram[location], charmap, sizeof(lcd->cgram[location]));
+    lcd->cgram_valid |= 1 << location;
+    return ret;
 }  // lcd_create_char()
 
 // Write a byte to the LCD
-void lcd_write(i2c_lcd_pcf8574_handle_t* lcd, uint8_t value) {
+esp_err_t lcd_write(i2c_lcd_pcf8574_handle_t* lcd, uint8_t value) {
+    LCD_NO_ALLOC_SCOPE(lcd);
+    // Direct writes bypass the framebuffer, so the DDRAM mirror can no longer be trusted
+    lcd_ddram_invalidate(lcd);
     lcd_send(lcd, value, true);
+    return lcd_finish(lcd);
 }  // lcd_write()
 
 // Print characters to the LCD: cursor set or clear instruction must preceded this instruction, or it will write on the current text.
-void lcd_print(i2c_lcd_pcf8574_handle_t* lcd, const char* str) {
-    while (*str) {
-        lcd_write(lcd, *str++);
-    }
+esp_err_t lcd_print(i2c_lcd_pcf8574_handle_t* lcd, const char* str) {
+    LCD_NO_ALLOC_SCOPE(lcd);
+    return lcd_write_buffer(lcd, (const uint8_t*)str, strlen(str));
 }  // lcd_print()
 
 // Additional function to print numbers as formatted string
-void lcd_print_number(i2c_lcd_pcf8574_handle_t* lcd, uint8_t col, uint8_t row, uint8_t buf_len, const char *str, ...) {
+esp_err_t lcd_print_number(i2c_lcd_pcf8574_handle_t* lcd, uint8_t col, uint8_t row, uint8_t buf_len, const char *str, ...) {
+    LCD_NO_ALLOC_SCOPE(lcd);
     //  Ensure the buffer length is greater than zero
     if (buf_len == 0)
     {
         ESP_LOGE(TAG, "Buffer length must be greater than 0");
+        return ESP_ERR_INVALID_ARG;
     }
 
     //  Create a buffer to hold the characters
@@ -281,55 +429,271 @@ void lcd_print_number(i2c_lcd_pcf8574_handle_t* lcd, uint8_t col, uint8_t row, u
 
     if (chars_written < 0) {
         ESP_LOGE(TAG, "Encoding error in vsnprintf");
+        return ESP_FAIL;
     }
 
     if ((size_t)chars_written >= buf_len) {
         ESP_LOGW(TAG, "Buffer overflow: %d characters needed, but only %d available", chars_written + 1, buf_len);
     }
 
+    lcd_batch_begin(lcd);
     lcd_set_cursor(lcd, col, row);
     lcd_print(lcd, buffer);
-    
+    return lcd_batch_commit(lcd);
 }  // lcd_print_number()
 
+// Start a batch: all following LCD operations are collected in the handle and sent together
+esp_err_t lcd_batch_begin(i2c_lcd_pcf8574_handle_t* lcd) {
+    lcd->batch_depth++;
+    return ESP_OK;
+}  // lcd_batch_begin()
 
-// Private functions: derived from the esp32 i2c_master driver
+// End a batch: the collected operations go out as one START + address + data + STOP transaction.
+// The HD44780 needs ~37us per instruction; each LCD byte is 4 expander bytes on the wire
+// (~90us at 400kHz), so back-to-back bytes in one transaction already respect that gap.
+esp_err_t lcd_batch_commit(i2c_lcd_pcf8574_handle_t* lcd) {
+    LCD_NO_ALLOC_SCOPE(lcd);
+    ESP_RETURN_ON_FALSE(lcd->batch_depth > 0, ESP_ERR_INVALID_STATE, TAG, "lcd_batch_commit() without lcd_batch_begin()");
+    if (--lcd->batch_depth == 0) {
+        lcd_batch_flush(lcd);
+    }
+    return lcd_finish(lcd);
+}  // lcd_batch_commit()
 
+// Write a buffer of bytes to the LCD in a single transaction
+esp_err_t lcd_write_buffer(i2c_lcd_pcf8574_handle_t* lcd, const uint8_t* data, size_t len) {
+    LCD_NO_ALLOC_SCOPE(lcd);
+    lcd_ddram_invalidate(lcd);
+    lcd_batch_begin(lcd);
+    // Encode straight into the batch buffer, as many bytes as fit at a time
+    while (len > 0) {
+        size_t room = (LCD_BATCH_BUF_SIZE - lcd->batch_len) / 4;
+        if (room == 0) {
+            lcd_batch_flush(lcd);
+            continue;
+        }
+        size_t n = (len < room) ? len : room;
+        lcd->batch_len += lcd_encode_bytes(lcd, data, n, true, &lcd->batch_buf[1 + lcd->batch_len]);
+        LCD_PERF_COUNT(lcd, true, n);
+        for (size_t i = 0; i < n; i++) {
+            lcd_track(lcd, data[i], true);
+        }
+        data += n;
+        len -= n;
+    }
+    return lcd_batch_commit(lcd);
+}  // lcd_write_buffer()
 
-static void lcd_send(i2c_lcd_pcf8574_handle_t* lcd, uint8_t value, bool is_data) {
-    i2c_cmd_handle_t cmd = i2c_cmd_link_create();
-    i2c_master_start(cmd);
-    i2c_master_write_byte(cmd, (lcd->i2c_addr << 1) | I2C_MASTER_WRITE, true);
-    lcd_write_nibble(lcd, (value >> 4 & 0x0F), is_data, cmd);
-    lcd_write_nibble(lcd, (value & 0x0F), is_data, cmd);
-    i2c_master_stop(cmd);
-    esp_err_t ret = i2c_master_cmd_begin(lcd->i2c_port, cmd, I2C_MASTER_TIMEOUT_MS / portTICK_PERIOD_MS);
-    i2c_cmd_link_delete(cmd);
-    
-    if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to send data to LCD: %s", esp_err_to_name(ret));
+// Write characters that are encoded already, only the backlight bits are added on the way
+esp_err_t lcd_write_encoded(i2c_lcd_pcf8574_handle_t* lcd, const uint8_t* wire, size_t len) {
+    LCD_NO_ALLOC_SCOPE(lcd);
+    ESP_RETURN_ON_FALSE(len % 4 == 0, ESP_ERR_INVALID_ARG, TAG, "%u bytes are no whole characters", (unsigned)len);
+    const uint8_t bl = LCD_BACKLIGHT_BITS(lcd);
+    // Behind a 16-bit expander every second byte goes to the data port, which has no backlight pin
+    const uint8_t bl_odd = LCD_EXPANDER_8BIT(lcd) ? 0x00 : bl;
+
+    lcd_ddram_invalidate(lcd);
+    lcd_batch_begin(lcd);
+    while (len > 0) {
+        size_t room = (LCD_BATCH_BUF_SIZE - lcd->batch_len) / 4 * 4;
+        if (room == 0) {
+            lcd_batch_flush(lcd);
+            continue;
+        }
+        size_t n = (len < room) ? len : room;
+        for (size_t i = 0; i < n; i++) {
+            lcd->batch_buf[1 + lcd->batch_len++] = wire[i] | ((i & 1) ? bl_odd : bl);
+        }
+        LCD_PERF_COUNT(lcd, true, n / 4);
+        for (size_t i = 0; i < n; i += 4) {
+            // Data writes only move the address counter, the value doesn't matter
+            lcd_track(lcd, 0, true);
+        }
+        wire += n;
+        len -= n;
+    }
+    return lcd_batch_commit(lcd);
+}  // lcd_write_encoded()
+
+// Use a different PCF8574 pin assignment and rebuild the encoding tables
+esp_err_t lcd_set_pin_map(i2c_lcd_pcf8574_handle_t* lcd, uint8_t rs_mask, uint8_t rw_mask, uint8_t enable_mask,
+                          uint8_t backlight_mask, const uint8_t data_mask[4]) {
+#if CONFIG_LCD_PCF8574_FIXED_PINMAP
+    ESP_LOGE(TAG, "Pin map is fixed by CONFIG_LCD_PCF8574_FIXED_PINMAP");
+    return ESP_ERR_NOT_SUPPORTED;
+#else
+    lcd->rs_mask = rs_mask;
+    lcd->rw_mask = rw_mask;
+    lcd->enable_mask = enable_mask;
+    lcd->backlight_mask = backlight_mask;
+    memcpy(lcd->data_mask, data_mask, sizeof(lcd->data_mask));
+    lcd->expander = LCD_EXPANDER_PCF8574;
+    lcd_build_lut(lcd);
+    return ESP_OK;
+#endif
+}  // lcd_set_pin_map()
+
+// Turn a byte string into its complete wire sequence: 4 expander bytes per input byte
+size_t lcd_encode_bytes(const i2c_lcd_pcf8574_handle_t* lcd, const uint8_t* src, size_t len, bool is_data, uint8_t* out) {
+    const uint8_t (*lut)[2] = LCD_LUT(lcd)[is_data ? 1 : 0];
+    const uint8_t bl = LCD_BACKLIGHT_BITS(lcd);
+
+#if !CONFIG_LCD_PCF8574_FIXED_PINMAP
+    if (LCD_EXPANDER_8BIT(lcd)) {
+        // One E pulse: (control with E, data), then (control, data) latches the byte on the falling edge
+        const uint8_t control = (is_data ? lcd->rs_mask : 0x00) | bl;
+        for (size_t i = 0; i < len; i++) {
+            const uint8_t data = lcd->data_lut[0][src[i] & 0x0F] | lcd->data_lut[1][src[i] >> 4];
+            out[0] = control | lcd->enable_mask;
+            out[1] = data;
+            out[2] = control;
+            out[3] = data;
+            out += 4;
+        }
+        return len * 4;
     }
+#endif
+    for (size_t i = 0; i < len; i++) {
+        const uint8_t* hi = lut[src[i] >> 4];
+        const uint8_t* lo = lut[src[i] & 0x0F];
+        out[0] = hi[0] | bl;
+        out[1] = hi[1] | bl;
+        out[2] = lo[0] | bl;
+        out[3] = lo[1] | bl;
+        out += 4;
+    }
+    return len * 4;
+}  // lcd_encode_bytes()
+
+
+// Private functions: derived from the esp32 i2c_master driver
+
+
+void lcd_send(i2c_lcd_pcf8574_handle_t* lcd, uint8_t value, bool is_data) {
+    uint8_t wire[4];
+    lcd_encode_bytes(lcd, &value, 1, is_data, wire);
+    LCD_PERF_COUNT(lcd, is_data, 1);
+    lcd_queue(lcd, wire, sizeof(wire));
+    lcd_track(lcd, value, is_data);
 }  // lcd_send()
 
-// Write a nibble / half byte with ACK
-static void lcd_write_nibble(i2c_lcd_pcf8574_handle_t* lcd, uint8_t half_byte, bool is_data, i2c_cmd_handle_t cmd) {
+// Set the DDRAM address, unless the address counter is there already
+void lcd_set_address(i2c_lcd_pcf8574_handle_t* lcd, uint8_t addr) {
+    if (lcd->ac == addr) {
+        LCD_PERF_ELIDED(lcd);
+        return;
+    }
+    // Instruction: Set DDRAM address = 0x80
+    lcd_send(lcd, 0x80 | addr, false);
+}  // lcd_set_address()
 
-    // Map the data to the given pin connections
-    uint8_t data = is_data ? lcd->rs_mask : 0;
+// Send the display control of the handle, unless the controller has it already
+void lcd_send_displaycontrol(i2c_lcd_pcf8574_handle_t* lcd) {
+    if (lcd->sent_displaycontrol == lcd->displaycontrol) {
+        LCD_PERF_ELIDED(lcd);
+        return;
+    }
+    // Instruction: Display mode: 0x08
+    lcd_send(lcd, 0x08 | lcd->displaycontrol, false);
+}  // lcd_send_displaycontrol()
 
-    // Don't use rw_mask here
-    if (lcd->backlight > 0) {
-        data |= lcd->backlight_mask;
+// Send the entry mode of the handle, unless the controller has it already
+void lcd_send_entrymode(i2c_lcd_pcf8574_handle_t* lcd) {
+    if (lcd->sent_entrymode == lcd->entrymode) {
+        LCD_PERF_ELIDED(lcd);
+        return;
     }
-    // Allow arbitrary pin configuration
-    if (half_byte & 0x01) data |= lcd->data_mask[0];
-    if (half_byte & 0x02) data |= lcd->data_mask[1];
-    if (half_byte & 0x04) data |= lcd->data_mask[2];
-    if (half_byte & 0x08) data |= lcd->data_mask[3];
+    // Instruction: Entry mode set = 0x04
+    lcd_send(lcd, 0x04 | lcd->entrymode, false);
+}  // lcd_send_entrymode()
+
+// Forget the modeled controller state: the next commands are all sent
+void lcd_forget_state(i2c_lcd_pcf8574_handle_t* lcd) {
+    lcd->ac = -1;
+    lcd->sent_displaycontrol = LCD_STATE_UNKNOWN;
+    lcd->sent_entrymode = LCD_STATE_UNKNOWN;
+}  // lcd_forget_state()
+
+// Next DDRAM address after a write: in 2-line mode DDRAM runs 0x00..0x27 and 0x40..0x67
+static int16_t lcd_ac_next(const i2c_lcd_pcf8574_handle_t* lcd, int16_t ac, bool increment) {
+    if (lcd->lines <= 1) {
+        return (ac + (increment ? 1 : LCD_DDRAM_SIZE - 1)) % LCD_DDRAM_SIZE;
+    }
+    if (increment) {
+        return ac == 0x27 ? 0x40 : ac == 0x67 ? 0x00 : ac + 1;
+    }
+    return ac == 0x40 ? 0x27 : ac == 0x00 ? 0x67 : ac - 1;
+}  // lcd_ac_next()
+
+// Follow what a byte queued for the controller does to its address counter, display control and
+// entry mode. Autoscroll only moves the display, the address counter steps the same way.
+static void lcd_track(i2c_lcd_pcf8574_handle_t* lcd, uint8_t value, bool is_data) {
+    const bool direction_known = lcd->sent_entrymode != LCD_STATE_UNKNOWN;
+    const bool increment = lcd->sent_entrymode & 0x02;
+
+    if (is_data || (value & 0xF8) == 0x10) {
+        // Data write (in CGRAM the DDRAM address stays unknown) or cursor shift
+        if (lcd->ac >= 0) {
+            lcd->ac = !direction_known ? -1 : is_data ? lcd_ac_next(lcd, lcd->ac, increment)
+                                                      : lcd_ac_next(lcd, lcd->ac, value & 0x04);
+        }
+    } else if (value & 0x80) {
+        lcd->ac = value & 0x7F;
+    } else if (value & 0x40) {
+        // Set CGRAM address
+        lcd->ac = -1;
+    } else if (value & 0x20) {
+        // Function set: only sent while (re)initializing
+        lcd_forget_state(lcd);
+    } else if (value & 0x10) {
+        // Display shift: the address counter stays
+    } else if (value & 0x08) {
+        lcd->sent_displaycontrol = value & 0x07;
+    } else if (value & 0x04) {
+        lcd->sent_entrymode = value & 0x03;
+    } else if (value & 0x02) {
+        lcd->ac = 0;
+    } else if (value & 0x01) {
+        // Clear display also sets the entry mode to increment
+        lcd->ac = 0;
+        if (direction_known) {
+            lcd->sent_entrymode |= 0x02;
+        }
+    }
+}  // lcd_track()
+
+// Send a single command nibble on its own, only used by the reset sequence
+static void lcd_send_nibble(i2c_lcd_pcf8574_handle_t* lcd, uint8_t half_byte) {
+    const uint8_t bl = LCD_BACKLIGHT_BITS(lcd);
+    uint8_t wire[2] = {
+        LCD_LUT(lcd)[0][half_byte & 0x0F][0] | bl,
+        LCD_LUT(lcd)[0][half_byte & 0x0F][1] | bl,
+    };
+    LCD_PERF_COUNT(lcd, false, 1);
+    lcd_queue(lcd, wire, sizeof(wire));
+    lcd_forget_state(lcd);
+}  // lcd_send_nibble()
 
-    i2c_master_write_byte(cmd, data | lcd->enable_mask, true);
-    i2c_master_write_byte(cmd, data, true);
-}  // lcd_write_nibble()
+// Build the expander bytes (E high, E low) of every command and data nibble for the pin map.
+// The backlight bit is left out and added while encoding, so switching it needs no rebuild.
+static void lcd_build_lut(i2c_lcd_pcf8574_handle_t* lcd) {
+#if !CONFIG_LCD_PCF8574_FIXED_PINMAP
+    for (uint8_t half_byte = 0; half_byte < 16; half_byte++) {
+        // Allow arbitrary pin configuration
+        uint8_t data = 0;
+        if (half_byte & 0x01) data |= lcd->data_mask[0];
+        if (half_byte & 0x02) data |= lcd->data_mask[1];
+        if (half_byte & 0x04) data |= lcd->data_mask[2];
+        if (half_byte & 0x08) data |= lcd->data_mask[3];
+
+        // Don't use rw_mask here
+        lcd->nibble_lut[0][half_byte][0] = data | lcd->enable_mask;
+        lcd->nibble_lut[0][half_byte][1] = data;
+        lcd->nibble_lut[1][half_byte][0] = data | lcd->rs_mask | lcd->enable_mask;
+        lcd->nibble_lut[1][half_byte][1] = data | lcd->rs_mask;
+    }
+#endif
+}  // lcd_build_lut()
 
 // Private function to change the PCF8574 pins to the given value.
 static void lcd_write_i2c(i2c_lcd_pcf8574_handle_t* lcd, uint8_t data, bool is_data, bool enable) {
@@ -343,15 +707,448 @@ static void lcd_write_i2c(i2c_lcd_pcf8574_handle_t* lcd, uint8_t data, bool is_d
         data |= lcd->backlight_mask;
     }
 
-    i2c_cmd_handle_t cmd = i2c_cmd_link_create();
-    i2c_master_start(cmd);
-    i2c_master_write_byte(cmd, (lcd->i2c_addr << 1) | I2C_MASTER_WRITE, true);
-    i2c_master_write_byte(cmd, data, true);
-    i2c_master_stop(cmd);
-    esp_err_t ret = i2c_master_cmd_begin(lcd->i2c_port, cmd, I2C_MASTER_TIMEOUT_MS / portTICK_PERIOD_MS);
-    i2c_cmd_link_delete(cmd);
+    // A 16-bit expander takes the control port and the data port
+    const uint8_t pins[2] = { data, 0x00 };
+    lcd_queue(lcd, pins, LCD_EXPANDER_8BIT(lcd) ? 2 : 1);
+}  // lcd_write_i2c()
+
+// Append expander bytes to the open batch, or send them right away when no batch is open
+static void lcd_queue(i2c_lcd_pcf8574_handle_t* lcd, const uint8_t* bytes, size_t len) {
+    if (lcd->batch_depth == 0) {
+        lcd_transmit(lcd, bytes, len);
+        return;
+    }
+    if (lcd->batch_len + len > LCD_BATCH_BUF_SIZE) {
+        lcd_batch_flush(lcd);
+    }
+    memcpy(&lcd->batch_buf[1 + lcd->batch_len], bytes, len);
+    lcd->batch_len += len;
+}  // lcd_queue()
+
+// Send whatever is in the batch buffer without closing the batch
+void lcd_batch_flush(i2c_lcd_pcf8574_handle_t* lcd) {
+    if (lcd->batch_len > 0) {
+        lcd_transmit(lcd, &lcd->batch_buf[1], lcd->batch_len);
+        lcd->batch_len = 0;
+    }
+}  // lcd_batch_flush()
+
+// Note a slow instruction: the controller takes nothing new for the given time
+void lcd_set_busy(i2c_lcd_pcf8574_handle_t* lcd, uint32_t us) {
+    lcd->ready_at_us = esp_timer_get_time() + us;
+}  // lcd_set_busy()
 
+// Wake up the task sleeping in lcd_wait_sleep()
+static void lcd_wait_wake(void* arg) {
+    i2c_lcd_pcf8574_handle_t* lcd = arg;
+    xSemaphoreGive(lcd->wait_sem);
+}  // lcd_wait_wake()
+
+esp_err_t lcd_wait_setup(i2c_lcd_pcf8574_handle_t* lcd) {
+    if (lcd->wait_timer != NULL) {
+        return ESP_OK;
+    }
+    const esp_timer_create_args_t args = {
+        .callback = lcd_wait_wake,
+        .arg = lcd,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "lcd_wait",
+    };
+    return esp_timer_create(&args, &lcd->wait_timer);
+}  // lcd_wait_setup()
+
+// Sleep on the wait timer. A wake up that came after an earlier sleep gave up is taken first,
+// the timer must not be left running for the next one.
+static void lcd_wait_sleep(i2c_lcd_pcf8574_handle_t* lcd, int64_t us) {
+    int64_t start = esp_timer_get_time();
+    xSemaphoreTake(lcd->wait_sem, 0);
+    if (esp_timer_start_once(lcd->wait_timer, us) != ESP_OK) {
+        return;
+    }
+    if (xSemaphoreTake(lcd->wait_sem, 2) != pdTRUE) {
+        esp_timer_stop(lcd->wait_timer);
+    }
+    lcd_perf_wait(lcd, esp_timer_get_time() - start, true);
+}  // lcd_wait_sleep()
+
+// Wait until the controller is ready: nothing to do if the deadline passed already,
+// sleep for whole ticks of a long wait, on the wait timer for the rest of the ticks
+// and only spin for the last LCD_WAIT_SPIN_US. A failed busy flag read fails the
+// running operation, see lcd_transmit_failed().
+void lcd_wait_ready(i2c_lcd_pcf8574_handle_t* lcd) {
+    LCD_NO_ALLOC_SCOPE(lcd);
+    int64_t remaining = lcd->ready_at_us - esp_timer_get_time();
+    if (remaining <= 0) {
+        return;
+    }
+    if (lcd->busy_poll && remaining > LCD_POLL_MIN_US) {
+        // Ask the controller instead of waiting the worst case time
+        uint8_t value;
+        esp_err_t ret;
+        while ((ret = lcd_read_busy(lcd, &value)) == ESP_OK) {
+            if (!(value & 0x80)) {
+                lcd->ready_at_us = 0;
+                return;
+            }
+            if (esp_timer_get_time() >= lcd->ready_at_us) {
+                break;
+            }
+        }
+        if (ret != ESP_OK) {
+            // A failed transaction like any other, this wait ends at the deadline
+            lcd_transmit_failed(lcd, ret);
+        } else {
+            // Still busy after the worst case time: the read-back does not work
+            ESP_LOGW(TAG, "Busy flag stays set, using fixed delays");
+            lcd->busy_poll = false;
+        }
+        remaining = lcd->ready_at_us - esp_timer_get_time();
+    }
+    if (remaining >= LCD_YIELD_MIN_US) {
+        int64_t start = esp_timer_get_time();
+        vTaskDelay(remaining / LCD_YIELD_MIN_US);
+        lcd_perf_wait(lcd, esp_timer_get_time() - start, true);
+        remaining = lcd->ready_at_us - esp_timer_get_time();
+    }
+    if (remaining > 2 * LCD_WAIT_SPIN_US && lcd->wait_timer != NULL && !lcd->wait_spin) {
+        lcd_wait_sleep(lcd, remaining - LCD_WAIT_SPIN_US);
+        remaining = lcd->ready_at_us - esp_timer_get_time();
+    }
+    if (remaining > 0) {
+        lcd->transport.delay_us(lcd->transport.ctx, remaining);
+        lcd_perf_wait(lcd, remaining, false);
+    }
+}  // lcd_wait_ready()
+
+// Read the busy flag and address counter. With RW high and the data pins released (written high,
+// the PCF8574 pins are quasi-bidirectional) each E pulse puts one nibble on D4..D7.
+static esp_err_t lcd_read_busy(i2c_lcd_pcf8574_handle_t* lcd, uint8_t* value) {
+    const uint8_t pins = lcd->data_mask[0] | lcd->data_mask[1] | lcd->data_mask[2] | lcd->data_mask[3];
+    const uint8_t idle = pins | lcd->rw_mask | (lcd->backlight > 0 ? lcd->backlight_mask : 0);
+    uint8_t result = 0;
+
+    for (int i = 0; i < 2; i++) {
+        uint8_t wire[2] = { idle, idle | lcd->enable_mask };
+        uint8_t rx;
+        esp_err_t ret = lcd_transfer(lcd, wire, sizeof(wire), &rx, 1);
+        if (ret != ESP_OK) {
+            return ret;
+        }
+        result <<= 4;
+        if (rx & lcd->data_mask[0]) result |= 0x01;
+        if (rx & lcd->data_mask[1]) result |= 0x02;
+        if (rx & lcd->data_mask[2]) result |= 0x04;
+        if (rx & lcd->data_mask[3]) result |= 0x08;
+    }
+    *value = result;
+    // End the second read cycle with E low, then drop RW while E stays low
+    uint8_t wire[2] = { idle, idle & ~lcd->rw_mask };
+    return lcd_transfer(lcd, wire, sizeof(wire), NULL, 0);
+}  // lcd_read_busy()
+
+// Enable busy flag polling. RW must be wired: this is checked by setting the address counter
+// and reading it back. The cursor ends up in the home position.
+esp_err_t lcd_set_busy_polling(i2c_lcd_pcf8574_handle_t* lcd, bool enable) {
+    LCD_NO_ALLOC_SCOPE(lcd);
+    lcd->busy_poll = false;
+    if (!enable) {
+        return ESP_OK;
+    }
+    ESP_RETURN_ON_FALSE(!LCD_EXPANDER_8BIT(lcd), ESP_ERR_NOT_SUPPORTED, TAG, "No busy flag read-back through a 16-bit expander");
+    ESP_RETURN_ON_FALSE(lcd->transport.write_read != NULL, ESP_ERR_NOT_SUPPORTED, TAG, "The transport can't read");
+
+    // lcd_init() leaves RW unwired: asking for polling with the default pin map means it sits on
+    // P1 as on the common backpacks. It stays unwired if the read-back does not work.
+    const uint8_t rw_mask = lcd->rw_mask;
+    if (rw_mask == 0 && lcd_default_pin_map(lcd)) {
+        lcd->rw_mask = 0x02;
+    }
+    ESP_RETURN_ON_FALSE(lcd->rw_mask != 0, ESP_ERR_NOT_SUPPORTED, TAG, "RW is not wired");
+    esp_err_t ret = lcd_busy_probe(lcd);
+    if (ret != ESP_OK) {
+        lcd->rw_mask = rw_mask;
+        return ret;
+    }
+    lcd->busy_poll = true;
+    return ESP_OK;
+}  // lcd_set_busy_polling()
+
+// The pin map lcd_init() sets up
+static bool lcd_default_pin_map(const i2c_lcd_pcf8574_handle_t* lcd) {
+    static const uint8_t data_mask[4] = { 0x10, 0x20, 0x40, 0x80 };
+    return lcd->expander == LCD_EXPANDER_PCF8574 && lcd->rs_mask == 0x01 && lcd->enable_mask == 0x04 &&
+           lcd->backlight_mask == 0x08 && memcmp(lcd->data_mask, data_mask, sizeof(data_mask)) == 0;
+}  // lcd_default_pin_map()
+
+// Check the busy flag read-back: set the address counter and read it back
+static esp_err_t lcd_busy_probe(i2c_lcd_pcf8574_handle_t* lcd) {
+    // Instruction: Set DDRAM address = 0x80
+    const uint8_t probe = 0x05;
+    lcd_send(lcd, 0x80 | probe, false);
+    lcd_batch_flush(lcd);
+    LCD_RETURN_ON_ERROR(lcd_finish(lcd));
+    uint8_t value = 0x80;
+    for (int tries = 0; tries < 3 && (value & 0x80); tries++) {
+        if (lcd_read_busy(lcd, &value) != ESP_OK) {
+            break;
+        }
+    }
+    lcd_send(lcd, 0x80, false);
+    lcd_batch_flush(lcd);
+    LCD_RETURN_ON_ERROR(lcd_finish(lcd));
+
+    ESP_RETURN_ON_FALSE(value == probe, ESP_ERR_NOT_SUPPORTED, TAG, "Busy flag read-back does not work");
+    return ESP_OK;
+}  // lcd_busy_probe()
+
+// Read the controller's address counter
+esp_err_t lcd_read_address_counter(i2c_lcd_pcf8574_handle_t* lcd, uint8_t* address) {
+    LCD_NO_ALLOC_SCOPE(lcd);
+    ESP_RETURN_ON_FALSE(lcd->busy_poll, ESP_ERR_NOT_SUPPORTED, TAG, "Busy flag polling is not enabled");
+    ESP_RETURN_ON_FALSE(!lcd->breaker_open, ESP_ERR_INVALID_STATE, TAG, "Display is offline");
+    lcd_batch_flush(lcd);
+    LCD_RETURN_ON_ERROR(lcd_finish(lcd));
+    lcd_wait_ready(lcd);
+    LCD_RETURN_ON_ERROR(lcd_finish(lcd));
+
+    uint8_t value;
+    ESP_RETURN_ON_ERROR(lcd_read_busy(lcd, &value), TAG, "Failed to read the address counter");
+    *address = value & 0x7F;
+    return ESP_OK;
+}  // lcd_read_address_counter()
+
+// Send through another transport
+esp_err_t lcd_set_transport(i2c_lcd_pcf8574_handle_t* lcd, const lcd_transport_t* transport) {
+    ESP_RETURN_ON_FALSE(transport != NULL && transport->write != NULL && transport->delay_us != NULL,
+                        ESP_ERR_INVALID_ARG, TAG, "A transport needs write and delay_us");
+    lcd->transport = *transport;
+    if (transport->write_read == NULL) {
+        lcd->busy_poll = false;
+    }
+    return ESP_OK;
+}  // lcd_set_transport()
+
+// Set the timeout of each I2C transaction
+esp_err_t lcd_set_timeout(i2c_lcd_pcf8574_handle_t* lcd, uint32_t timeout_ms) {
+    ESP_RETURN_ON_FALSE(timeout_ms > 0, ESP_ERR_INVALID_ARG, TAG, "Timeout must be greater than 0");
+    lcd->timeout_ms = timeout_ms;
+    return ESP_OK;
+}  // lcd_set_timeout()
+
+// Configure the circuit breaker: threshold consecutive failures take the display offline
+esp_err_t lcd_set_circuit_breaker(i2c_lcd_pcf8574_handle_t* lcd, uint8_t threshold, uint32_t backoff_min_ms, uint32_t backoff_max_ms) {
+    ESP_RETURN_ON_FALSE(backoff_min_ms > 0 && backoff_min_ms <= backoff_max_ms, ESP_ERR_INVALID_ARG, TAG, "Invalid backoff");
+    lcd->breaker_threshold = threshold;
+    lcd->backoff_min_ms = backoff_min_ms;
+    lcd->backoff_max_ms = backoff_max_ms;
+    if (threshold == 0) {
+        lcd->breaker_open = false;
+    }
+    return ESP_OK;
+}  // lcd_set_circuit_breaker()
+
+// Check if the circuit breaker took the display offline
+bool lcd_is_offline(const i2c_lcd_pcf8574_handle_t* lcd) {
+    return lcd->breaker_open;
+}  // lcd_is_offline()
+
+// End of a public operation: hand out its first bus error. Errors inside a batch wait for the
+// outermost commit. A display that came back gets its state restored here, outside any batch.
+esp_err_t lcd_finish(i2c_lcd_pcf8574_handle_t* lcd) {
+    esp_err_t ret = lcd->bus_err;
+    if (ret != ESP_OK) {
+        // Some of the commands the model followed never arrived
+        lcd_forget_state(lcd);
+    }
+    if (lcd->batch_depth > 0) {
+        return ret;
+    }
+    lcd->bus_err = ESP_OK;
+    if (lcd->recover_pending) {
+        lcd->recover_pending = false;
+        lcd_recover(lcd);
+    }
+    return ret;
+}  // lcd_finish()
+
+// A transaction failed: fail the rest of the operation fast and open the breaker after
+// threshold failures in a row. Only the failures before that are logged.
+void lcd_transmit_failed(i2c_lcd_pcf8574_handle_t* lcd, esp_err_t err) {
+    lcd->bus_err = err;
+    // Whatever the batch held may or may not have reached the display
+    lcd_ddram_invalidate(lcd);
+    ESP_LOGE(TAG, "Failed to send data to LCD 0x%02x: %s", lcd->i2c_addr, esp_err_to_name(err));
+    if (lcd->breaker_threshold > 0 && ++lcd->failures >= lcd->breaker_threshold) {
+        ESP_LOGE(TAG, "LCD 0x%02x is offline, writes fail until it answers again", lcd->i2c_addr);
+        lcd->breaker_open = true;
+        lcd->backoff_ms = lcd->backoff_min_ms;
+        lcd->probe_at_us = esp_timer_get_time() + lcd->backoff_ms * 1000LL;
+    }
+}  // lcd_transmit_failed()
+
+// Send expander bytes to the PCF8574 as one I2C transaction. Once a transaction of the running
+// operation failed, or while the display is offline, nothing goes on the bus.
+void lcd_transmit(i2c_lcd_pcf8574_handle_t* lcd, const uint8_t* bytes, size_t len) {
+    if (lcd->bus_err != ESP_OK) {
+        return;
+    }
+    if (lcd->breaker_open) {
+        // Dropped either way: the display is offline or it just came back without its state
+        lcd_breaker_probe(lcd);
+        lcd->bus_err = ESP_ERR_INVALID_STATE;
+        lcd_ddram_invalidate(lcd);
+        return;
+    }
+
+    lcd_wait_ready(lcd);
+    if (lcd->bus_err != ESP_OK) {
+        // The busy flag read failed
+        return;
+    }
+    esp_err_t ret = lcd_transfer(lcd, bytes, len, NULL, 0);
     if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to write to LCD: %s", esp_err_to_name(ret));
+        lcd_transmit_failed(lcd, ret);
+        return;
+    }
+    lcd->failures = 0;
+}  // lcd_transmit()
+
+// The display is offline: check if it answers again, backing off exponentially while it does not.
+// The bytes of the operation that finds it back are dropped, the controller lost its state
+// anyway; lcd_finish() restores it once the operation is over.
+static void lcd_breaker_probe(i2c_lcd_pcf8574_handle_t* lcd) {
+    if (esp_timer_get_time() < lcd->probe_at_us) {
+        return;
+    }
+
+    // All control pins low, only the backlight: nothing happens on the controller side
+    const uint8_t idle[2] = { LCD_BACKLIGHT_BITS(lcd), 0x00 };
+    if (lcd_transfer(lcd, idle, LCD_EXPANDER_8BIT(lcd) ? 2 : 1, NULL, 0) != ESP_OK) {
+        lcd->backoff_ms = (lcd->backoff_ms * 2 < lcd->backoff_max_ms) ? lcd->backoff_ms * 2 : lcd->backoff_max_ms;
+        lcd->probe_at_us = esp_timer_get_time() + lcd->backoff_ms * 1000LL;
+        return;
+    }
+
+    ESP_LOGI(TAG, "LCD 0x%02x answers again, restoring its state", lcd->i2c_addr);
+    lcd->breaker_open = false;
+    lcd->failures = 0;
+    lcd->recover_pending = true;
+}  // lcd_breaker_probe()
+
+// Initialize a display that came back and bring back what it showed: display and entry mode,
+// custom characters and the framebuffer
+static void lcd_recover(i2c_lcd_pcf8574_handle_t* lcd) {
+    const uint8_t displaycontrol = lcd->displaycontrol;
+    const uint8_t entrymode = lcd->entrymode;
+    uint8_t fb[LCD_DDRAM_SIZE];
+    memcpy(fb, lcd->fb, sizeof(fb));
+
+    if (lcd_begin(lcd, lcd->cols, lcd->lines) != ESP_OK) {
+        return;
+    }
+    lcd->displaycontrol = displaycontrol;
+    lcd->entrymode = entrymode;
+    lcd_batch_begin(lcd);
+    lcd_send_displaycontrol(lcd);
+    lcd_send_entrymode(lcd);
+    lcd_batch_commit(lcd);
+    for (uint8_t location = 0; location < 8; location++) {
+        if (lcd->cgram_valid & (1 << location)) {
+            lcd_create_char(lcd, location, lcd->cgram[location]);
+        }
+    }
+    memcpy(lcd->fb, fb, sizeof(fb));
+    lcd_flush(lcd);
+}  // lcd_recover()
+
+// Write expander bytes and optionally read the pins back after a repeated start. Behind a 16-bit
+// expander the register byte goes in front: into the head byte of the batch buffer, or together
+// with a short transaction into a copy on the stack.
+static esp_err_t lcd_transfer(i2c_lcd_pcf8574_handle_t* lcd, const uint8_t* bytes, size_t len, uint8_t* rx, size_t rx_len) {
+    uint8_t prefixed[1 + LCD_TRANSFER_SHORT_MAX];
+    LCD_NO_ALLOC_SCOPE(lcd);
+
+    if (LCD_EXPANDER_8BIT(lcd)) {
+        if (bytes == &lcd->batch_buf[1]) {
+            lcd->batch_buf[0] = lcd->expander_reg;
+            bytes = lcd->batch_buf;
+        } else {
+            ESP_RETURN_ON_FALSE(len <= LCD_TRANSFER_SHORT_MAX, ESP_ERR_INVALID_SIZE, TAG, "%u bytes outside of the batch", (unsigned)len);
+            prefixed[0] = lcd->expander_reg;
+            memcpy(&prefixed[1], bytes, len);
+            bytes = prefixed;
+        }
+        len++;
+    }
+
+    int64_t start = esp_timer_get_time();
+    esp_err_t ret = (rx_len > 0)
+        ? lcd->transport.write_read(lcd->transport.ctx, bytes, len, rx, rx_len, lcd->timeout_ms)
+        : lcd->transport.write(lcd->transport.ctx, bytes, len, lcd->timeout_ms);
+    // Bytes on the wire: the address byte, then the address byte again for a read
+    lcd_perf_transfer(lcd, 1 + len + (rx_len > 0 ? 1 + rx_len : 0), esp_timer_get_time() - start, ret);
+    return ret;
+}  // lcd_transfer()
+
+#if CONFIG_LCD_PCF8574_ASSERT_NO_ALLOC
+// Note the calling task as inside a driver call. With more tasks in calls than slots the call
+// goes unchecked.
+i2c_lcd_pcf8574_handle_t* lcd_no_alloc_enter(i2c_lcd_pcf8574_handle_t* lcd) {
+    TaskHandle_t task = xTaskGetCurrentTaskHandle();
+    int slot = -1;
+
+    portENTER_CRITICAL_SAFE(&lcd->no_alloc_lock);
+    for (int i = 0; i < LCD_NO_ALLOC_TASKS; i++) {
+        if (lcd->no_alloc_task[i] == task) {
+            slot = i;
+            break;
+        }
+        if (slot < 0 && lcd->no_alloc_task[i] == NULL) {
+            slot = i;
+        }
+    }
+    if (slot >= 0) {
+        lcd->no_alloc_task[slot] = task;
+        lcd->no_alloc_depth[slot]++;
+    }
+    portEXIT_CRITICAL_SAFE(&lcd->no_alloc_lock);
+    return (slot >= 0) ? lcd : NULL;
+}  // lcd_no_alloc_enter()
+
+// The driver call of lcd_no_alloc_enter() is over
+void lcd_no_alloc_leave(i2c_lcd_pcf8574_handle_t** handle) {
+    i2c_lcd_pcf8574_handle_t* lcd = *handle;
+    if (lcd == NULL) {
+        return;
+    }
+    TaskHandle_t task = xTaskGetCurrentTaskHandle();
+
+    portENTER_CRITICAL_SAFE(&lcd->no_alloc_lock);
+    for (int i = 0; i < LCD_NO_ALLOC_TASKS; i++) {
+        if (lcd->no_alloc_task[i] == task) {
+            if (--lcd->no_alloc_depth[i] == 0) {
+                lcd->no_alloc_task[i] = NULL;
+            }
+            break;
+        }
+    }
+    portEXIT_CRITICAL_SAFE(&lcd->no_alloc_lock);
+}  // lcd_no_alloc_leave()
+#endif
+
+// Abort on an allocation of a task inside a driver call. Runs in the heap allocation hook of the
+// application: no lock, nothing that could allocate.
+void lcd_check_alloc(const i2c_lcd_pcf8574_handle_t* lcd) {
+#if CONFIG_LCD_PCF8574_ASSERT_NO_ALLOC
+    if (!lcd->no_alloc) {
+        return;
+    }
+    TaskHandle_t task = xTaskGetCurrentTaskHandle();
+    for (int i = 0; i < LCD_NO_ALLOC_TASKS; i++) {
+        if (lcd->no_alloc_task[i] == task) {
+            esp_rom_printf("LCD 0x%02x: heap allocation inside a driver call\n", lcd->i2c_addr);
+            abort();
+        }
     }
-}  // lcd_write_i2c()
\ No newline at end of file
+#endif
+}  // lcd_check_alloc()
\ No newline at end of file
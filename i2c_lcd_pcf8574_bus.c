@@ -0,0 +1,125 @@
+/// \file i2c_lcd_pcf8574_bus.c
+/// \brief Scheduler for several i2c_lcd_pcf8574 displays sharing one I2C port
+///
+/// \author Femi Olugbon, https://iamflinks.github.io
+/// \copyright Copyright (c) 2024 by Femi Olugbon
+///
+/// ChangeLog see: i2c_lcd_pcf8574.h
+
+#include <string.h>
+#include "i2c_lcd_pcf8574.h"
+#include "i2c_lcd_pcf8574_priv.h"
+#include "esp_log.h"
+#include "esp_check.h"
+#include "esp_timer.h"
+
+
+#define TAG "I2C_LCD_PCF8574"
+
+
+// Set up the scheduler
+void lcd_bus_init(lcd_bus_scheduler_t* bus, i2c_port_t i2c_port, uint16_t quantum) {
+    memset(bus, 0, sizeof(*bus));
+    bus->i2c_port = i2c_port;
+    bus->quantum = (quantum > 0) ? quantum : 1;
+    bus->stats_since_us = esp_timer_get_time();
+}  // lcd_bus_init()
+
+// Add a display to the scheduler
+esp_err_t lcd_bus_add(lcd_bus_scheduler_t* bus, i2c_lcd_pcf8574_handle_t* lcd) {
+    ESP_RETURN_ON_FALSE(bus->count < LCD_BUS_MAX_DISPLAYS, ESP_ERR_NO_MEM, TAG, "Bus scheduler is full");
+    ESP_RETURN_ON_FALSE(lcd->i2c_port == bus->i2c_port, ESP_ERR_INVALID_ARG, TAG, "Display is on another I2C port");
+    for (uint8_t i = 0; i < bus->count; i++) {
+        ESP_RETURN_ON_FALSE(bus->displays[i]->i2c_addr != lcd->i2c_addr, ESP_ERR_INVALID_ARG, TAG,
+                            "Address 0x%02x is already on the bus", lcd->i2c_addr);
+    }
+    bus->displays[bus->count++] = lcd;
+    return ESP_OK;
+}  // lcd_bus_add()
+
+// One round: every display gets a turn of at most `quantum` cells in a single transaction.
+// A display whose controller is still executing a slow instruction is skipped instead of waited
+// for, so the bus keeps serving the others. The first turn rotates between rounds for fairness.
+bool lcd_bus_service(lcd_bus_scheduler_t* bus) {
+    bus->pending = 0;
+
+    for (uint8_t n = 0; n < bus->count; n++) {
+        uint8_t i = (bus->next + n) % bus->count;
+        i2c_lcd_pcf8574_handle_t* lcd = bus->displays[i];
+        size_t sent;
+        bool pending;
+
+        if (lcd->ready_at_us > esp_timer_get_time()) {
+            // A zero cell step only checks for dirty cells
+            lcd_flush_step(lcd, 0, &sent, &pending);
+            if (pending) {
+                bus->stats[i].busy_skips++;
+                bus->pending |= 1 << i;
+            }
+            continue;
+        }
+        esp_err_t ret = lcd_flush_step(lcd, bus->quantum, &sent, &pending);
+        if (ret != ESP_OK) {
+            // A failed display does not count as pending, so it can't keep lcd_bus_flush_all() spinning
+            bus->stats[i].errors++;
+            if (bus->err == ESP_OK) {
+                bus->err = ret;
+            }
+            continue;
+        }
+        if (sent > 0) {
+            bus->stats[i].cells += sent;
+            bus->stats[i].transactions++;
+        }
+        if (pending) {
+            bus->pending |= 1 << i;
+        }
+    }
+    if (bus->count > 0) {
+        bus->next = (bus->next + 1) % bus->count;
+    }
+    return bus->pending != 0;
+}  // lcd_bus_service()
+
+// Flush everything. Only when every display with work left is busy does the scheduler wait,
+// and then only for the controller that becomes ready first.
+esp_err_t lcd_bus_flush_all(lcd_bus_scheduler_t* bus) {
+    bus->err = ESP_OK;
+    while (lcd_bus_service(bus)) {
+        i2c_lcd_pcf8574_handle_t* first = NULL;
+        int64_t now = esp_timer_get_time();
+        for (uint8_t i = 0; i < bus->count; i++) {
+            i2c_lcd_pcf8574_handle_t* lcd = bus->displays[i];
+            if (!(bus->pending & (1 << i))) {
+                continue;
+            }
+            if (lcd->ready_at_us <= now) {
+                // Someone can make progress right away
+                first = NULL;
+                break;
+            }
+            if (first == NULL || lcd->ready_at_us < first->ready_at_us) {
+                first = lcd;
+            }
+        }
+        if (first != NULL) {
+            lcd_wait_ready(first);
+        }
+    }
+    return bus->err;
+}  // lcd_bus_flush_all()
+
+// Copy the statistics of one display
+esp_err_t lcd_bus_get_stats(lcd_bus_scheduler_t* bus, uint8_t index, lcd_bus_stats_t* stats) {
+    ESP_RETURN_ON_FALSE(index < bus->count, ESP_ERR_INVALID_ARG, TAG, "No display at index %d", index);
+    *stats = bus->stats[index];
+    int64_t elapsed = esp_timer_get_time() - bus->stats_since_us;
+    stats->cells_per_sec = (elapsed > 0) ? (uint32_t)((int64_t)stats->cells * 1000000 / elapsed) : 0;
+    return ESP_OK;
+}  // lcd_bus_get_stats()
+
+// Reset the statistics
+void lcd_bus_reset_stats(lcd_bus_scheduler_t* bus) {
+    memset(bus->stats, 0, sizeof(bus->stats));
+    bus->stats_since_us = esp_timer_get_time();
+}  // lcd_bus_reset_stats()
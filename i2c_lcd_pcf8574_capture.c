@@ -0,0 +1,59 @@
+/// \file i2c_lcd_pcf8574_capture.c
+/// \brief In-memory transport of the i2c_lcd_pcf8574 driver
+///
+/// Collects the expander bytes of every transaction back to back instead of sending them, to
+/// look at what the driver puts on the wire without a bus: golden byte streams, sizing
+/// transactions, or replaying them on another bus later.
+///
+/// \author Femi Olugbon, https://iamflinks.github.io
+/// \copyright Copyright (c) 2024 by Femi Olugbon
+///
+/// ChangeLog see: i2c_lcd_pcf8574.h
+
+#include <stdint.h>
+#include <string.h>
+#include "i2c_lcd_pcf8574.h"
+
+
+static esp_err_t lcd_capture_write(void* ctx, const uint8_t* bytes, size_t len, uint32_t timeout_ms) {
+    lcd_capture_t* capture = ctx;
+    size_t room = capture->size - capture->len;
+
+    if (len > room) {
+        capture->overflow = true;
+        len = room;
+    }
+    memcpy(&capture->buf[capture->len], bytes, len);
+    capture->len += len;
+    capture->transactions++;
+    return ESP_OK;
+}  // lcd_capture_write()
+
+// Nothing to wait for: the bytes are collected and done is called right away
+static esp_err_t lcd_capture_write_async(void* ctx, const uint8_t* bytes, size_t len, uint32_t timeout_ms,
+                                         lcd_transport_done_t done, void* arg) {
+    esp_err_t ret = lcd_capture_write(ctx, bytes, len, timeout_ms);
+    done(arg, ret);
+    return ESP_OK;
+}  // lcd_capture_write_async()
+
+static void lcd_capture_delay_us(void* ctx, uint32_t us) {
+    lcd_capture_t* capture = ctx;
+    capture->delay_us += us;
+}  // lcd_capture_delay_us()
+
+// Transport that collects the bytes in buf. Nothing can be read back, so busy flag
+// polling is not available.
+void lcd_transport_capture(lcd_transport_t* transport, lcd_capture_t* capture, uint8_t* buf, size_t size) {
+    capture->buf = buf;
+    capture->size = size;
+    capture->len = 0;
+    capture->transactions = 0;
+    capture->overflow = false;
+    capture->delay_us = 0;
+    transport->write = lcd_capture_write;
+    transport->write_read = NULL;
+    transport->delay_us = lcd_capture_delay_us;
+    transport->write_async = lcd_capture_write_async;
+    transport->ctx = capture;
+}  // lcd_transport_capture()
@@ -0,0 +1,258 @@
+/// \file i2c_lcd_pcf8574_console.c
+/// \brief Scrolling text console for the i2c_lcd_pcf8574 driver
+///
+/// The lines live in a ring in RAM. Scrolling moves the ring, not the display: the rows are drawn
+/// into the framebuffer and lcd_flush() sends only the cells whose character changed, so a new
+/// line never costs a clear and rows that share text with the row below them are left alone.
+/// Writes only touch RAM under a spinlock; the bus is used by one flush at a time, at most once
+/// per rate limit interval, so a chatty logger can't make the display its bottleneck.
+///
+/// \author Femi Olugbon, https://iamflinks.github.io
+/// \copyright Copyright (c) 2024 by Femi Olugbon
+///
+/// ChangeLog see: i2c_lcd_pcf8574.h
+
+#include <stdio.h>
+#include <string.h>
+#include "i2c_lcd_pcf8574.h"
+#include "i2c_lcd_pcf8574_priv.h"
+#include "esp_log.h"
+#include "esp_check.h"
+
+
+#define TAG "I2C_LCD_PCF8574"
+
+// Where the console is in an ANSI escape sequence (ESC [ parameters final byte)
+#define LCD_CONSOLE_ESC_NONE 0
+#define LCD_CONSOLE_ESC_START 1
+#define LCD_CONSOLE_ESC_CSI 2
+
+// Console the log output goes to and the sink that was installed before
+static lcd_console_t* s_log_console;
+static vprintf_like_t s_log_prev;
+
+
+// Set up a console on the whole display
+esp_err_t lcd_console_init(lcd_console_t* console, i2c_lcd_pcf8574_handle_t* lcd, bool wrap, uint32_t min_interval_ms) {
+    ESP_RETURN_ON_FALSE(lcd->cols <= LCD_CONSOLE_MAX_COLS && lcd->cols * lcd->lines <= LCD_DDRAM_SIZE,
+                        ESP_ERR_INVALID_SIZE, TAG, "Console supports up to %d columns", LCD_CONSOLE_MAX_COLS);
+
+    memset(console, 0, sizeof(*console));
+    console->lcd = lcd;
+    portMUX_INITIALIZE(&console->lock);
+    console->wrap = wrap;
+    console->newest = LCD_MAX_ROWS - 1;
+    console->min_interval_us = min_interval_ms * 1000LL;
+    // The first flush blanks whatever the display showed before
+    console->dirty = true;
+    return ESP_OK;
+}  // lcd_console_init()
+
+// Finish the line being written. Unless it was cut by the wrap, a line equal to the newest one
+// only counts up the repeats of that one.
+static void lcd_console_end_line(lcd_console_t* console, bool wrapped) {
+    lcd_console_line_t* cur = &console->cur;
+    lcd_console_line_t* newest = &console->lines[console->newest];
+
+    if (!wrapped && console->count > 0 && !newest->wrapped && cur->len > 0 && cur->len == newest->len &&
+        memcmp(cur->text, newest->text, cur->len) == 0) {
+        if (newest->repeats < UINT16_MAX) {
+            newest->repeats++;
+        }
+        console->lines_collapsed++;
+    } else {
+        console->newest = (console->newest + 1) % LCD_MAX_ROWS;
+        console->lines[console->newest] = *cur;
+        console->lines[console->newest].wrapped = wrapped;
+        console->lines[console->newest].repeats = 1;
+        if (console->count < LCD_MAX_ROWS) {
+            console->count++;
+        }
+        console->lines_added++;
+    }
+    cur->len = 0;
+    console->dirty = true;
+}  // lcd_console_end_line()
+
+// Take one character of the text
+static void lcd_console_put(lcd_console_t* console, char c) {
+    lcd_console_line_t* cur = &console->cur;
+
+    // Colors and cursor movements of log output are dropped with their parameters
+    if (console->esc == LCD_CONSOLE_ESC_START) {
+        console->esc = (c == '[') ? LCD_CONSOLE_ESC_CSI : LCD_CONSOLE_ESC_NONE;
+        return;
+    }
+    if (console->esc == LCD_CONSOLE_ESC_CSI) {
+        if (c >= 0x40 && c <= 0x7E) {
+            console->esc = LCD_CONSOLE_ESC_NONE;
+        }
+        return;
+    }
+
+    switch (c) {
+    case '\033':
+        console->esc = LCD_CONSOLE_ESC_START;
+        return;
+    case '\n':
+        lcd_console_end_line(console, false);
+        return;
+    case '\r':
+        cur->len = 0;
+        console->dirty = true;
+        return;
+    case '\t':
+        c = ' ';
+        break;
+    default:
+        if ((uint8_t)c < 0x20) {
+            return;
+        }
+        break;
+    }
+
+    if (cur->len == console->lcd->cols) {
+        if (!console->wrap) {
+            return;
+        }
+        lcd_console_end_line(console, true);
+    }
+    cur->text[cur->len++] = c;
+    console->dirty = true;
+}  // lcd_console_put()
+
+// Draw the lines into the framebuffer: the newest at the bottom, or the line being written once
+// it has text. Repeated lines get their counter at the end of the row.
+static void lcd_console_render(lcd_console_t* console) {
+    i2c_lcd_pcf8574_handle_t* lcd = console->lcd;
+    const uint8_t finished_rows = (console->cur.len > 0) ? lcd->lines - 1 : lcd->lines;
+
+    for (uint8_t row = 0; row < lcd->lines; row++) {
+        uint8_t* cells = &lcd->fb[row * lcd->cols];
+        const lcd_console_line_t* line = NULL;
+
+        if (row >= finished_rows) {
+            line = &console->cur;
+        } else if (finished_rows - 1 - row < console->count) {
+            line = &console->lines[(console->newest + LCD_MAX_ROWS - (finished_rows - 1 - row)) % LCD_MAX_ROWS];
+        }
+        memset(cells, ' ', lcd->cols);
+        if (line == NULL) {
+            continue;
+        }
+        memcpy(cells, line->text, line->len);
+        if (line->repeats > 1) {
+            char counter[8];
+            int len = snprintf(counter, sizeof(counter), " x%u", line->repeats);
+            if (len <= lcd->cols) {
+                memcpy(cells + lcd->cols - len, counter, len);
+            }
+        }
+    }
+}  // lcd_console_render()
+
+// Send the changes, unless another write is flushing them already or the rate limit holds them
+// back. Changes that come in during the flush are sent after it when the rate limit allows.
+static esp_err_t lcd_console_flush(lcd_console_t* console) {
+    for (;;) {
+        const int64_t now = esp_timer_get_time();
+
+        portENTER_CRITICAL_SAFE(&console->lock);
+        if (!console->dirty || console->flushing || now < console->next_flush_us) {
+            if (console->dirty && !console->flushing) {
+                console->flushes_held++;
+            }
+            portEXIT_CRITICAL_SAFE(&console->lock);
+            return ESP_OK;
+        }
+        console->flushing = true;
+        console->dirty = false;
+        lcd_console_render(console);
+        portEXIT_CRITICAL_SAFE(&console->lock);
+
+        esp_err_t ret = lcd_flush(console->lcd);
+
+        portENTER_CRITICAL_SAFE(&console->lock);
+        console->flushing = false;
+        console->next_flush_us = now + console->min_interval_us;
+        console->flushes++;
+        if (ret != ESP_OK) {
+            // The framebuffer stays as drawn, the next write or poll tries again
+            console->dirty = true;
+        }
+        portEXIT_CRITICAL_SAFE(&console->lock);
+        if (ret != ESP_OK) {
+            return ret;
+        }
+    }
+}  // lcd_console_flush()
+
+// Write text
+esp_err_t lcd_console_write(lcd_console_t* console, const char* text, size_t len) {
+    LCD_NO_ALLOC_SCOPE(console->lcd);
+    portENTER_CRITICAL_SAFE(&console->lock);
+    for (size_t i = 0; i < len; i++) {
+        lcd_console_put(console, text[i]);
+    }
+    portEXIT_CRITICAL_SAFE(&console->lock);
+    return lcd_console_flush(console);
+}  // lcd_console_write()
+
+// Write formatted text
+esp_err_t lcd_console_printf(lcd_console_t* console, const char* format, ...) {
+    LCD_NO_ALLOC_SCOPE(console->lcd);
+    char text[LCD_CONSOLE_TEXT_MAX];
+    va_list args;
+
+    va_start(args, format);
+    int len = vsnprintf(text, sizeof(text), format, args);
+    va_end(args);
+    ESP_RETURN_ON_FALSE(len >= 0, ESP_ERR_INVALID_ARG, TAG, "Encoding error");
+    return lcd_console_write(console, text, (len < (int)sizeof(text)) ? (size_t)len : sizeof(text) - 1);
+}  // lcd_console_printf()
+
+// Flush what the rate limit held back
+esp_err_t lcd_console_poll(lcd_console_t* console) {
+    LCD_NO_ALLOC_SCOPE(console->lcd);
+    return lcd_console_flush(console);
+}  // lcd_console_poll()
+
+// Send the log output to a console as well
+void lcd_console_set_log_sink(lcd_console_t* console) {
+    if (console != NULL && s_log_console == NULL) {
+        s_log_console = console;
+        s_log_prev = esp_log_set_vprintf(lcd_console_vprintf);
+    } else if (console == NULL && s_log_console != NULL) {
+        esp_log_set_vprintf(s_log_prev);
+        s_log_console = NULL;
+        s_log_prev = NULL;
+    } else {
+        s_log_console = console;
+    }
+}  // lcd_console_set_log_sink()
+
+// vprintf-style sink. Log messages of the driver itself (a failing flush) only land in the ring:
+// the flush running already picks them up, or the next write does.
+int lcd_console_vprintf(const char* format, va_list args) {
+    lcd_console_t* console = s_log_console;
+    int ret = 0;
+
+    if (s_log_prev != NULL) {
+        va_list copy;
+        va_copy(copy, args);
+        ret = s_log_prev(format, copy);
+        va_end(copy);
+    }
+    if (console != NULL) {
+        LCD_NO_ALLOC_SCOPE(console->lcd);
+        char text[LCD_CONSOLE_TEXT_MAX];
+        int len = vsnprintf(text, sizeof(text), format, args);
+        if (len > 0) {
+            lcd_console_write(console, text, (len < (int)sizeof(text)) ? (size_t)len : sizeof(text) - 1);
+        }
+        if (s_log_prev == NULL) {
+            ret = len;
+        }
+    }
+    return ret;
+}  // lcd_console_vprintf()
@@ -0,0 +1,97 @@
+/// \file i2c_lcd_pcf8574_expander.c
+/// \brief 8-bit mode through 16-bit I2C expanders (MCP23017, PCA9555) for the i2c_lcd_pcf8574 driver
+///
+/// RS, RW, E and the backlight sit on one port, D0..D7 on the other. Both expanders are set up so
+/// that the bytes of a transaction alternate between the two output registers, so every byte pair
+/// on the wire is (control port, data port) and a character is one E pulse.
+///
+/// \author Femi Olugbon, https://iamflinks.github.io
+/// \copyright Copyright (c) 2024 by Femi Olugbon
+///
+/// ChangeLog see: i2c_lcd_pcf8574.h
+
+#include <stdint.h>
+#include "i2c_lcd_pcf8574.h"
+#include "i2c_lcd_pcf8574_priv.h"
+#include "esp_log.h"
+#include "esp_check.h"
+
+
+#define TAG "I2C_LCD_PCF8574"
+
+// MCP23017 registers with IOCON.BANK = 0
+#define MCP23017_IODIRA 0x00
+#define MCP23017_IOCON  0x0A
+#define MCP23017_OLATA  0x14
+// IOCON.SEQOP: no address increment, the register pointer toggles between the A and B registers
+#define MCP23017_SEQOP  0x20
+
+// PCA9555 registers: the pointer always toggles between the two registers of a pair
+#define PCA9555_OUTPUT0 0x02
+#define PCA9555_CONFIG0 0x06
+
+
+// Use a 16-bit expander in 8-bit mode, or go back to the PCF8574
+esp_err_t lcd_set_expander(i2c_lcd_pcf8574_handle_t* lcd, lcd_expander_t expander, uint8_t rs_mask, uint8_t rw_mask,
+                           uint8_t enable_mask, uint8_t backlight_mask, const uint8_t data_mask[8]) {
+#if CONFIG_LCD_PCF8574_FIXED_PINMAP
+    ESP_LOGE(TAG, "Pin map is fixed by CONFIG_LCD_PCF8574_FIXED_PINMAP");
+    return ESP_ERR_NOT_SUPPORTED;
+#else
+    if (expander == LCD_EXPANDER_PCF8574) {
+        static const uint8_t pcf8574_data[4] = { 0x10, 0x20, 0x40, 0x80 };
+        return lcd_set_pin_map(lcd, 0x01, 0x02, 0x04, 0x08, pcf8574_data);
+    }
+    ESP_RETURN_ON_FALSE(expander == LCD_EXPANDER_MCP23017 || expander == LCD_EXPANDER_PCA9555, ESP_ERR_INVALID_ARG,
+                        TAG, "Unknown expander %d", expander);
+    ESP_RETURN_ON_FALSE(enable_mask != 0, ESP_ERR_INVALID_ARG, TAG, "E is not wired");
+
+    lcd->expander = expander;
+    lcd->expander_reg = (expander == LCD_EXPANDER_MCP23017) ? MCP23017_OLATA : PCA9555_OUTPUT0;
+    lcd->rs_mask = rs_mask;
+    lcd->rw_mask = rw_mask;
+    lcd->enable_mask = enable_mask;
+    lcd->backlight_mask = backlight_mask;
+    // A byte is looked up as two nibbles: 32 bytes of tables instead of 256
+    for (uint8_t half_byte = 0; half_byte < 16; half_byte++) {
+        lcd->data_lut[0][half_byte] = 0;
+        lcd->data_lut[1][half_byte] = 0;
+        for (uint8_t bit = 0; bit < 4; bit++) {
+            if (half_byte & (1 << bit)) {
+                lcd->data_lut[0][half_byte] |= data_mask ? data_mask[bit] : 1 << bit;
+                lcd->data_lut[1][half_byte] |= data_mask ? data_mask[bit + 4] : 1 << (bit + 4);
+            }
+        }
+    }
+    // Busy flag polling would have to turn the data port around
+    lcd->busy_poll = false;
+    return ESP_OK;
+#endif
+}  // lcd_set_expander()
+
+// Write the register pair starting at `reg` in a transaction of its own
+static void lcd_expander_write(i2c_lcd_pcf8574_handle_t* lcd, uint8_t reg, uint8_t control, uint8_t data) {
+    const uint8_t output_reg = lcd->expander_reg;
+    const uint8_t bytes[2] = { control, data };
+
+    lcd->expander_reg = reg;
+    lcd_transmit(lcd, bytes, sizeof(bytes));
+    lcd->expander_reg = output_reg;
+}  // lcd_expander_write()
+
+// Both expanders power up with all pins as inputs. The outputs get their idle levels (E low)
+// before the pins are switched to outputs, so E never pulses on the way.
+void lcd_expander_setup(i2c_lcd_pcf8574_handle_t* lcd) {
+    const uint8_t idle = (lcd->backlight > 0) ? lcd->backlight_mask : 0x00;
+
+    lcd_batch_flush(lcd);
+    if (lcd->expander == LCD_EXPANDER_MCP23017) {
+        // IOCON is mirrored at 0x0A and 0x0B, the second byte lands there as well
+        lcd_expander_write(lcd, MCP23017_IOCON, MCP23017_SEQOP, MCP23017_SEQOP);
+        lcd_expander_write(lcd, MCP23017_OLATA, idle, 0x00);
+        lcd_expander_write(lcd, MCP23017_IODIRA, 0x00, 0x00);
+    } else {
+        lcd_expander_write(lcd, PCA9555_OUTPUT0, idle, 0x00);
+        lcd_expander_write(lcd, PCA9555_CONFIG0, 0x00, 0x00);
+    }
+}  // lcd_expander_setup()
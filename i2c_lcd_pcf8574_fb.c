@@ -0,0 +1,121 @@
+/// \file i2c_lcd_pcf8574_fb.c
+/// \brief Shadow framebuffer for the i2c_lcd_pcf8574 driver
+///
+/// \author Femi Olugbon, https://iamflinks.github.io
+/// \copyright Copyright (c) 2024 by Femi Olugbon
+///
+/// ChangeLog see: i2c_lcd_pcf8574.h
+
+#include <stdint.h>
+#include <string.h>
+#include "i2c_lcd_pcf8574.h"
+#include "i2c_lcd_pcf8574_priv.h"
+#include "esp_log.h"
+#include "esp_check.h"
+
+
+#define TAG "I2C_LCD_PCF8574"
+
+
+// Index of a framebuffer cell, or -1 when the position is outside the display
+static int lcd_fb_cell(const i2c_lcd_pcf8574_handle_t* lcd, uint8_t col, uint8_t row) {
+    if (lcd->cols * lcd->lines > LCD_DDRAM_SIZE) {
+        ESP_LOGE(TAG, "Framebuffer supports up to %d characters", LCD_DDRAM_SIZE);
+        return -1;
+    }
+    if (col >= lcd->cols || row >= lcd->lines) {
+        return -1;
+    }
+    return row * lcd->cols + col;
+}  // lcd_fb_cell()
+
+// Fill the framebuffer with spaces
+void lcd_fb_clear(i2c_lcd_pcf8574_handle_t* lcd) {
+    memset(lcd->fb, ' ', sizeof(lcd->fb));
+}  // lcd_fb_clear()
+
+// Put one character into the framebuffer
+void lcd_fb_write(i2c_lcd_pcf8574_handle_t* lcd, uint8_t col, uint8_t row, uint8_t value) {
+    int cell = lcd_fb_cell(lcd, col, row);
+    if (cell >= 0) {
+        lcd->fb[cell] = value;
+    }
+}  // lcd_fb_write()
+
+// Put a string into the framebuffer: text past the end of the row is dropped
+void lcd_fb_print(i2c_lcd_pcf8574_handle_t* lcd, uint8_t col, uint8_t row, const char* str) {
+    int cell = lcd_fb_cell(lcd, col, row);
+    if (cell < 0) {
+        return;
+    }
+    for (uint8_t c = col; c < lcd->cols && *str; c++) {
+        lcd->fb[cell++] = (uint8_t)*str++;
+    }
+}  // lcd_fb_print()
+
+// Forget the display content: the next flush rewrites everything
+void lcd_fb_invalidate(i2c_lcd_pcf8574_handle_t* lcd) {
+    lcd_ddram_invalidate(lcd);
+}  // lcd_fb_invalidate()
+
+// Send up to max_cells dirty cells in one batch. The address counter moves on by itself after each
+// character, so a set DDRAM address command is only needed where it is not at the next dirty cell.
+// While the display content is unknown, cells from flush_resync on count as dirty.
+esp_err_t lcd_flush_step(i2c_lcd_pcf8574_handle_t* lcd, size_t max_cells, size_t* sent_out, bool* pending) {
+    LCD_NO_ALLOC_SCOPE(lcd);
+    *sent_out = 0;
+    *pending = false;
+    ESP_RETURN_ON_FALSE(lcd->cols * lcd->lines <= LCD_DDRAM_SIZE, ESP_ERR_INVALID_SIZE, TAG,
+                        "Framebuffer supports up to %d characters", LCD_DDRAM_SIZE);
+
+    size_t sent = 0;
+
+    lcd_batch_begin(lcd);
+    for (uint8_t row = 0; row < lcd->lines && !*pending; row++) {
+        for (uint8_t col = 0; col < lcd->cols; col++) {
+            uint8_t cell = row * lcd->cols + col;
+            uint8_t value = lcd->fb[cell];
+            uint8_t addr = lcd->row_offsets[row] + col;
+            uint8_t index = lcd_ddram_index(lcd, addr);
+            bool unknown = !lcd->ddram_valid && cell >= lcd->flush_resync;
+
+            if (!unknown && lcd->ddram[index] == value) {
+                continue;
+            }
+            if (sent == max_cells) {
+                *pending = true;
+                break;
+            }
+            if (sent == 0) {
+                // The address counter model needs to know the direction it moves in. Only sent with
+                // a cell, so a step without dirty cells or of 0 cells stays off the bus.
+                lcd_send_entrymode(lcd);
+            }
+            lcd_set_address(lcd, addr);
+            lcd_send(lcd, value, true);
+            lcd->ddram[index] = value;
+            sent++;
+            if (unknown) {
+                lcd->flush_resync = cell + 1;
+            }
+        }
+    }
+    if (!*pending) {
+        lcd->ddram_valid = true;
+    }
+    *sent_out = sent;
+    esp_err_t ret = lcd_batch_commit(lcd);
+    if (ret != ESP_OK) {
+        // Some of the cells may not have made it: the next flush rewrites everything
+        lcd_ddram_invalidate(lcd);
+    }
+    return ret;
+}  // lcd_flush_step()
+
+// Send all dirty cells
+esp_err_t lcd_flush(i2c_lcd_pcf8574_handle_t* lcd) {
+    LCD_NO_ALLOC_SCOPE(lcd);
+    size_t sent;
+    bool pending;
+    return lcd_flush_step(lcd, SIZE_MAX, &sent, &pending);
+}  // lcd_flush()
@@ -0,0 +1,104 @@
+/// \file i2c_lcd_pcf8574_field.c
+/// \brief Numeric fields with incremental updates for the i2c_lcd_pcf8574 driver
+///
+/// \author Femi Olugbon, https://iamflinks.github.io
+/// \copyright Copyright (c) 2024 by Femi Olugbon
+///
+/// ChangeLog see: i2c_lcd_pcf8574.h
+
+#include <string.h>
+#include "i2c_lcd_pcf8574.h"
+#include "i2c_lcd_pcf8574_priv.h"
+#include "esp_log.h"
+#include "esp_check.h"
+
+
+#define TAG "I2C_LCD_PCF8574"
+
+// Most decimals a field shows: 10^9 still fits into an int32_t
+#define LCD_FIELD_MAX_DECIMALS 9
+
+
+// Format an integer as fixed point text without printf. Returns the length, the text is written
+// backwards from the end of `out` (which must hold 12 + LCD_FIELD_MAX_DECIMALS characters).
+static int lcd_field_format(int32_t value, uint8_t decimals, char* end) {
+    uint32_t magnitude = (value < 0) ? 0u - (uint32_t)value : (uint32_t)value;
+    char* p = end;
+    uint8_t digits = 0;
+
+    // At least one digit before the point, and zeros up to it ("0.05")
+    do {
+        *--p = '0' + magnitude % 10;
+        magnitude /= 10;
+        if (++digits == decimals) {
+            *--p = '.';
+        }
+    } while (magnitude > 0 || digits <= decimals);
+
+    if (value < 0) {
+        *--p = '-';
+    }
+    return end - p;
+}  // lcd_field_format()
+
+// Set up a numeric field
+void lcd_field_init(lcd_field_t* field, uint8_t col, uint8_t row, uint8_t width, uint8_t decimals, lcd_align_t align) {
+    field->col = col;
+    field->row = row;
+    field->width = (width > LCD_FIELD_MAX_WIDTH) ? LCD_FIELD_MAX_WIDTH : width;
+    field->decimals = (decimals > LCD_FIELD_MAX_DECIMALS) ? LCD_FIELD_MAX_DECIMALS : decimals;
+    field->align = align;
+    field->shown_valid = false;
+}  // lcd_field_init()
+
+// Show a new value. The differing characters go out as runs, one set DDRAM address command each,
+// all in one transaction. The framebuffer and DDRAM mirror are updated so lcd_flush() agrees.
+esp_err_t lcd_field_update(i2c_lcd_pcf8574_handle_t* lcd, lcd_field_t* field, int32_t value) {
+    LCD_NO_ALLOC_SCOPE(lcd);
+    ESP_RETURN_ON_FALSE(field->row < lcd->lines && field->col + field->width <= lcd->cols,
+                        ESP_ERR_INVALID_ARG, TAG, "Field outside the display");
+
+    char digits[12 + LCD_FIELD_MAX_DECIMALS];
+    int len = lcd_field_format(value, field->decimals, digits + sizeof(digits));
+    const char* number = digits + sizeof(digits) - len;
+
+    char text[LCD_FIELD_MAX_WIDTH];
+    esp_err_t ret = ESP_OK;
+    memset(text, ' ', field->width);
+    if (len > field->width) {
+        // Does not fit: show the overflow marker instead of a wrong number
+        memset(text, '#', field->width);
+        ret = ESP_ERR_INVALID_SIZE;
+    } else if (field->align == LCD_ALIGN_LEFT) {
+        memcpy(text, number, len);
+    } else {
+        memcpy(text + field->width - len, number, len);
+    }
+
+    lcd_batch_begin(lcd);
+    // The address counter model needs to know the direction it moves in
+    lcd_send_entrymode(lcd);
+    for (uint8_t i = 0; i < field->width; i++) {
+        if (field->shown_valid && field->shown[i] == text[i]) {
+            continue;
+        }
+        uint8_t col = field->col + i;
+        uint8_t addr = lcd->row_offsets[field->row] + col;
+        lcd_set_address(lcd, addr);
+        lcd_send(lcd, text[i], true);
+        if (lcd->cols * lcd->lines <= LCD_DDRAM_SIZE) {
+            lcd->fb[field->row * lcd->cols + col] = text[i];
+        }
+        lcd->ddram[lcd_ddram_index(lcd, addr)] = text[i];
+    }
+    esp_err_t bus_ret = lcd_batch_commit(lcd);
+    if (bus_ret != ESP_OK) {
+        // The display content is unknown now: the next update writes the whole field
+        field->shown_valid = false;
+        return bus_ret;
+    }
+
+    memcpy(field->shown, text, field->width);
+    field->shown_valid = true;
+    return ret;
+}  // lcd_field_update()
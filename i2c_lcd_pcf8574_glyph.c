@@ -0,0 +1,90 @@
+/// \file i2c_lcd_pcf8574_glyph.c
+/// \brief CGRAM glyph cache for the i2c_lcd_pcf8574 driver
+///
+/// \author Femi Olugbon, https://iamflinks.github.io
+/// \copyright Copyright (c) 2024 by Femi Olugbon
+///
+/// ChangeLog see: i2c_lcd_pcf8574.h
+
+#include <string.h>
+#include "i2c_lcd_pcf8574.h"
+#include "i2c_lcd_pcf8574_priv.h"
+#include "esp_log.h"
+#include "esp_check.h"
+
+
+#define TAG "I2C_LCD_PCF8574"
+
+
+// Check if a character code shows the given CGRAM slot (codes 8 - 15 mirror 0 - 7)
+static inline bool lcd_glyph_shows_slot(uint8_t value, uint8_t slot) {
+    return value < 16 && (value & 0x07) == slot;
+}  // lcd_glyph_shows_slot()
+
+// Check if a slot is used by the framebuffer or, when known, by what is on the display now
+static bool lcd_glyph_slot_in_use(const i2c_lcd_pcf8574_handle_t* lcd, uint8_t slot) {
+    for (uint8_t row = 0; row < lcd->lines; row++) {
+        for (uint8_t col = 0; col < lcd->cols; col++) {
+            if (lcd_glyph_shows_slot(lcd->fb[row * lcd->cols + col], slot)) {
+                return true;
+            }
+            if (lcd->ddram_valid &&
+                lcd_glyph_shows_slot(lcd->ddram[lcd_ddram_index(lcd, lcd->row_offsets[row] + col)], slot)) {
+                return true;
+            }
+        }
+    }
+    return false;
+}  // lcd_glyph_slot_in_use()
+
+// Find the slot holding a bitmap, uploading it if needed. Returns -1 if every slot is in use.
+// A failed upload still takes the slot: the bitmap is uploaded again when the display recovers.
+static int lcd_glyph_slot(i2c_lcd_pcf8574_handle_t* lcd, const uint8_t bitmap[8], esp_err_t* err) {
+    *err = ESP_OK;
+    // Already resident: nothing to send
+    for (uint8_t slot = 0; slot < 8; slot++) {
+        if ((lcd->cgram_valid & (1 << slot)) && memcmp(lcd->cgram[slot], bitmap, sizeof(lcd->cgram[slot])) == 0) {
+            return slot;
+        }
+    }
+
+    // Prefer a slot with unknown content, else the least recently used one that is not on screen
+    int victim = -1;
+    for (uint8_t slot = 0; slot < 8 && victim < 0; slot++) {
+        if (!(lcd->cgram_valid & (1 << slot))) {
+            victim = slot;
+        }
+    }
+    for (uint8_t slot = 0; slot < 8 && (victim < 0 || (lcd->cgram_valid & (1 << victim))); slot++) {
+        if ((victim < 0 || lcd->cgram_used[slot] < lcd->cgram_used[victim]) && !lcd_glyph_slot_in_use(lcd, slot)) {
+            victim = slot;
+        }
+    }
+
+    if (victim >= 0) {
+        *err = lcd_create_char(lcd, victim, (uint8_t*)bitmap);
+    }
+    return victim;
+}  // lcd_glyph_slot()
+
+// Character code of a bitmap: the slot the glyph cache keeps it in, marked as just used
+int lcd_glyph_code(i2c_lcd_pcf8574_handle_t* lcd, const uint8_t bitmap[8], esp_err_t* err) {
+    int slot = lcd_glyph_slot(lcd, bitmap, err);
+    if (slot >= 0) {
+        lcd->cgram_used[slot] = ++lcd->cgram_clock;
+    }
+    return slot;
+}  // lcd_glyph_code()
+
+// Put a custom character into the framebuffer
+esp_err_t lcd_fb_put_glyph(i2c_lcd_pcf8574_handle_t* lcd, uint8_t col, uint8_t row, const uint8_t bitmap[8]) {
+    LCD_NO_ALLOC_SCOPE(lcd);
+    ESP_RETURN_ON_FALSE(col < lcd->cols && row < lcd->lines, ESP_ERR_INVALID_ARG, TAG, "Position outside the display");
+
+    esp_err_t ret;
+    int slot = lcd_glyph_code(lcd, bitmap, &ret);
+    ESP_RETURN_ON_FALSE(slot >= 0, ESP_ERR_NO_MEM, TAG, "All 8 CGRAM slots are on screen");
+
+    lcd_fb_write(lcd, col, row, slot);
+    return ret;
+}  // lcd_fb_put_glyph()
@@ -0,0 +1,65 @@
+/// \file i2c_lcd_pcf8574_legacy.c
+/// \brief Transport of the i2c_lcd_pcf8574 driver through the legacy I2C driver (driver/i2c.h)
+///
+/// Each transaction is built in a command link that lives in lcd_legacy_bus_t, so sending does
+/// not touch the heap.
+///
+/// \author Femi Olugbon, https://iamflinks.github.io
+/// \copyright Copyright (c) 2024 by Femi Olugbon
+///
+/// ChangeLog see: i2c_lcd_pcf8574.h
+
+#include "sdkconfig.h"
+
+#if CONFIG_LCD_PCF8574_I2C_LEGACY
+
+#include <stdint.h>
+#include "i2c_lcd_pcf8574.h"
+#include "esp_rom_sys.h"
+
+
+// Write the bytes, then read rx_len bytes after a repeated start if asked to
+static esp_err_t lcd_legacy_transfer(lcd_legacy_bus_t* bus, const uint8_t* bytes, size_t len,
+                                     uint8_t* rx, size_t rx_len, uint32_t timeout_ms) {
+    i2c_cmd_handle_t cmd = i2c_cmd_link_create_static(bus->cmd_link_buf, sizeof(bus->cmd_link_buf));
+    i2c_master_start(cmd);
+    // We left-shift the device addres and add the read/write command
+    i2c_master_write_byte(cmd, (bus->addr << 1) | I2C_MASTER_WRITE, true);
+    i2c_master_write(cmd, bytes, len, true);
+    if (rx_len > 0) {
+        i2c_master_start(cmd);
+        i2c_master_write_byte(cmd, (bus->addr << 1) | I2C_MASTER_READ, true);
+        i2c_master_read(cmd, rx, rx_len, I2C_MASTER_LAST_NACK);
+    }
+    i2c_master_stop(cmd);
+    TickType_t ticks = pdMS_TO_TICKS(timeout_ms);
+    esp_err_t ret = i2c_master_cmd_begin(bus->port, cmd, (ticks > 0) ? ticks : 1);
+    i2c_cmd_link_delete_static(cmd);
+    return ret;
+}  // lcd_legacy_transfer()
+
+static esp_err_t lcd_legacy_write(void* ctx, const uint8_t* bytes, size_t len, uint32_t timeout_ms) {
+    return lcd_legacy_transfer(ctx, bytes, len, NULL, 0, timeout_ms);
+}  // lcd_legacy_write()
+
+static esp_err_t lcd_legacy_write_read(void* ctx, const uint8_t* bytes, size_t len, uint8_t* rx, size_t rx_len,
+                                       uint32_t timeout_ms) {
+    return lcd_legacy_transfer(ctx, bytes, len, rx, rx_len, timeout_ms);
+}  // lcd_legacy_write_read()
+
+static void lcd_legacy_delay_us(void* ctx, uint32_t us) {
+    esp_rom_delay_us(us);
+}  // lcd_legacy_delay_us()
+
+// Transport through the legacy I2C driver to the device at addr on port
+void lcd_transport_legacy(lcd_transport_t* transport, lcd_legacy_bus_t* bus, i2c_port_t port, uint8_t addr) {
+    bus->port = port;
+    bus->addr = addr;
+    transport->write = lcd_legacy_write;
+    transport->write_read = lcd_legacy_write_read;
+    transport->delay_us = lcd_legacy_delay_us;
+    transport->write_async = NULL;
+    transport->ctx = bus;
+}  // lcd_transport_legacy()
+
+#endif  // CONFIG_LCD_PCF8574_I2C_LEGACY
@@ -0,0 +1,307 @@
+/// \file i2c_lcd_pcf8574_marquee.c
+/// \brief Timer driven marquee for text longer than the display
+///
+/// Every row scrolls its own text at its own speed. Each step takes the cheaper way there is:
+/// * When all rows of a display with up to 2 rows scroll at the same speed, one display shift
+///   instruction moves all of them. Only the DDRAM cells that come into view and don't hold the
+///   right character yet are written: a text that fits into the DDRAM line is written once and
+///   then only shifted, a longer one costs one character per row and step.
+/// * Otherwise the rows that are due are redrawn in the framebuffer and lcd_flush() sends the
+///   cells that changed.
+///
+/// The steps run in the esp_timer task. They use the bus like any other call of the driver, so a
+/// slow bus or the return home after a failure delays the other esp_timer callbacks of the system.
+///
+/// \author Femi Olugbon, https://iamflinks.github.io
+/// \copyright Copyright (c) 2024 by Femi Olugbon
+///
+/// ChangeLog see: i2c_lcd_pcf8574.h
+
+#include <string.h>
+#include "i2c_lcd_pcf8574.h"
+#include "i2c_lcd_pcf8574_priv.h"
+#include "esp_log.h"
+#include "esp_check.h"
+
+
+#define TAG "I2C_LCD_PCF8574"
+
+// Time between attempts to get the display back in sync after a failed step
+#define LCD_MARQUEE_RETRY_MS 100
+
+
+// Characters the display shift rotates through: a DDRAM line, or all of DDRAM in 1-line mode
+static inline uint8_t lcd_marquee_ring(const i2c_lcd_pcf8574_handle_t* lcd) {
+    return (lcd->lines > 1) ? 40 : LCD_DDRAM_SIZE;
+}  // lcd_marquee_ring()
+
+// Check if a row scrolls
+static inline bool lcd_marquee_scrolls(const i2c_lcd_pcf8574_handle_t* lcd, const lcd_marquee_row_t* row) {
+    return row->text != NULL && row->len > lcd->cols;
+}  // lcd_marquee_scrolls()
+
+// Columns after which a scrolling text comes back. With the display shift a text that fits into
+// the ring repeats with the ring, so its cells never have to be written again.
+static size_t lcd_marquee_period(const i2c_lcd_pcf8574_handle_t* lcd, const lcd_marquee_row_t* row, bool shifting) {
+    size_t period = row->len + LCD_MARQUEE_GAP;
+    return (shifting && period < lcd_marquee_ring(lcd)) ? lcd_marquee_ring(lcd) : period;
+}  // lcd_marquee_period()
+
+// Character of a row at a display column
+static uint8_t lcd_marquee_char(const i2c_lcd_pcf8574_handle_t* lcd, const lcd_marquee_row_t* row, size_t column, bool shifting) {
+    size_t i = lcd_marquee_scrolls(lcd, row) ? (row->pos + column) % lcd_marquee_period(lcd, row, shifting) : column;
+    return (i < row->len) ? (uint8_t)row->text[i] : ' ';
+}  // lcd_marquee_char()
+
+// Check if one display shift can move all rows: every row scrolls at the same speed and the
+// rows don't share DDRAM lines
+static bool lcd_marquee_can_shift(const lcd_marquee_t* marquee) {
+    const i2c_lcd_pcf8574_handle_t* lcd = marquee->lcd;
+    if (lcd->lines > 2 || lcd->cols >= lcd_marquee_ring(lcd) || (lcd->entrymode & 0x03) != 0x02) {
+        return false;
+    }
+    for (uint8_t r = 0; r < lcd->lines; r++) {
+        if (!lcd_marquee_scrolls(lcd, &marquee->rows[r]) || marquee->rows[r].interval_ms != marquee->rows[0].interval_ms) {
+            return false;
+        }
+    }
+    return true;
+}  // lcd_marquee_can_shift()
+
+// Move all rows one column with the display shift. Before the shift the cells that come into view
+// get their characters; when the rows start shifting every cell of the ring is written once.
+static esp_err_t lcd_marquee_shift_step(lcd_marquee_t* marquee, int64_t now, const bool redraw[]) {
+    i2c_lcd_pcf8574_handle_t* lcd = marquee->lcd;
+    const uint8_t ring = lcd_marquee_ring(lcd);
+    const bool entering = !marquee->shifting;
+    const bool step = !entering && now >= marquee->rows[0].next_us;
+    const uint8_t shift = step ? (marquee->shift + 1) % ring : marquee->shift;
+
+    lcd_batch_begin(lcd);
+    for (uint8_t r = 0; r < lcd->lines; r++) {
+        lcd_marquee_row_t* row = &marquee->rows[r];
+        const size_t period = lcd_marquee_period(lcd, row, true);
+        const bool forced = entering || redraw[r];
+        if (step && !redraw[r]) {
+            row->pos = (row->pos + 1) % period;
+        }
+        const uint8_t cells = (forced || period == ring) ? ring : lcd->cols;
+        for (uint8_t k = 0; k < cells; k++) {
+            uint8_t value = lcd_marquee_char(lcd, row, k, true);
+            uint8_t addr = (r ? 0x40 : 0x00) + (shift + k) % ring;
+            uint8_t index = lcd_ddram_index(lcd, addr);
+            if (k < lcd->cols) {
+                lcd->fb[r * lcd->cols + k] = value;
+            }
+            if (!forced && lcd->ddram[index] == value) {
+                continue;
+            }
+            lcd_set_address(lcd, addr);
+            lcd_send(lcd, value, true);
+            lcd->ddram[index] = value;
+        }
+    }
+    if (step) {
+        // Instruction: Cursor or display shift = 0x10, shift the display left = 0x08
+        lcd_send(lcd, 0x18, false);
+    }
+    LCD_RETURN_ON_ERROR(lcd_batch_commit(lcd));
+
+    marquee->shift = shift;
+    marquee->shifting = true;
+    if (entering || step) {
+        // The rows share one schedule from here on
+        int64_t next = marquee->rows[0].next_us + marquee->rows[0].interval_ms * 1000LL;
+        if (entering || next <= now) {
+            next = now + marquee->rows[0].interval_ms * 1000LL;
+        }
+        for (uint8_t r = 0; r < lcd->lines; r++) {
+            marquee->rows[r].next_us = next;
+        }
+    }
+    if (step) {
+        marquee->shift_steps++;
+    }
+    return ESP_OK;
+}  // lcd_marquee_shift_step()
+
+// Redraw the rows that are due or got a new text in the framebuffer and flush the changes
+static esp_err_t lcd_marquee_redraw_step(lcd_marquee_t* marquee, int64_t now, const bool redraw[]) {
+    i2c_lcd_pcf8574_handle_t* lcd = marquee->lcd;
+    bool drawn = false;
+
+    marquee->shifting = false;
+    for (uint8_t r = 0; r < lcd->lines; r++) {
+        lcd_marquee_row_t* row = &marquee->rows[r];
+        bool due = lcd_marquee_scrolls(lcd, row) && now >= row->next_us;
+        if (!redraw[r] && !due) {
+            continue;
+        }
+        if (due) {
+            row->pos = (row->pos + 1) % lcd_marquee_period(lcd, row, false);
+            row->next_us += row->interval_ms * 1000LL;
+            if (row->next_us <= now) {
+                row->next_us = now + row->interval_ms * 1000LL;
+            }
+        }
+        for (uint8_t c = 0; c < lcd->cols; c++) {
+            lcd->fb[r * lcd->cols + c] = lcd_marquee_char(lcd, row, c, false);
+        }
+        drawn = true;
+    }
+    if (!drawn) {
+        return ESP_OK;
+    }
+    marquee->redraw_steps++;
+    return lcd_flush(lcd);
+}  // lcd_marquee_redraw_step()
+
+// Arm the timer for the next row that is due
+static void lcd_marquee_schedule(lcd_marquee_t* marquee, int64_t now) {
+    const i2c_lcd_pcf8574_handle_t* lcd = marquee->lcd;
+    int64_t next = marquee->resync ? now + LCD_MARQUEE_RETRY_MS * 1000LL : INT64_MAX;
+
+    for (uint8_t r = 0; r < lcd->lines; r++) {
+        if (lcd_marquee_scrolls(lcd, &marquee->rows[r]) && marquee->rows[r].next_us < next) {
+            next = marquee->rows[r].next_us;
+        }
+    }
+    if (next == INT64_MAX) {
+        return;
+    }
+    portENTER_CRITICAL(&marquee->lock);
+    if (!marquee->stopping) {
+        // Fails if lcd_marquee_set_text() armed it meanwhile, which is as good
+        esp_timer_start_once(marquee->timer, (next > now) ? next - now : 0);
+    }
+    portEXIT_CRITICAL(&marquee->lock);
+}  // lcd_marquee_schedule()
+
+// Timer callback: take new texts, get the display back in sync if needed and do the steps due
+static void lcd_marquee_tick(void* arg) {
+    lcd_marquee_t* marquee = (lcd_marquee_t*)arg;
+    i2c_lcd_pcf8574_handle_t* lcd = marquee->lcd;
+    const int64_t now = esp_timer_get_time();
+    bool redraw[LCD_MAX_ROWS] = { false };
+    LCD_NO_ALLOC_SCOPE(lcd);
+
+    portENTER_CRITICAL(&marquee->lock);
+    if (marquee->stopping) {
+        // Dispatched before lcd_marquee_stop() stopped the timer, the display is not ours anymore
+        portEXIT_CRITICAL(&marquee->lock);
+        return;
+    }
+    marquee->ticking = true;
+    for (uint8_t r = 0; r < lcd->lines; r++) {
+        lcd_marquee_row_t* row = &marquee->rows[r];
+        if (row->changed) {
+            row->changed = false;
+            row->text = row->next_text;
+            row->interval_ms = row->next_interval_ms;
+            redraw[r] = row->text != NULL;
+        }
+    }
+    portEXIT_CRITICAL(&marquee->lock);
+    // The wait timer would be dispatched by this task after the tick, short waits spin
+    lcd->wait_spin = true;
+
+    for (uint8_t r = 0; r < lcd->lines; r++) {
+        lcd_marquee_row_t* row = &marquee->rows[r];
+        if (redraw[r]) {
+            row->len = strlen(row->text);
+            row->pos = 0;
+            row->next_us = now + row->interval_ms * 1000LL;
+        }
+    }
+
+    const bool shifting = lcd_marquee_can_shift(marquee);
+    esp_err_t ret = ESP_OK;
+    if (marquee->resync || (marquee->shift != 0 && !shifting)) {
+        // Back to a known display shift of 0: what the ring holds there is in the DDRAM mirror,
+        // after a failure everything is drawn again anyway
+        ret = lcd_home(lcd);
+        if (ret == ESP_OK) {
+            marquee->shift = 0;
+            marquee->shifting = false;
+            for (uint8_t r = 0; r < lcd->lines; r++) {
+                redraw[r] = redraw[r] || (marquee->resync && marquee->rows[r].text != NULL);
+            }
+            marquee->resync = false;
+        }
+    }
+    if (ret == ESP_OK) {
+        ret = shifting ? lcd_marquee_shift_step(marquee, now, redraw) : lcd_marquee_redraw_step(marquee, now, redraw);
+    }
+    if (ret != ESP_OK) {
+        marquee->resync = true;
+    }
+    lcd_marquee_schedule(marquee, now);
+    lcd->wait_spin = false;
+
+    portENTER_CRITICAL(&marquee->lock);
+    marquee->ticking = false;
+    portEXIT_CRITICAL(&marquee->lock);
+}  // lcd_marquee_tick()
+
+// Start the marquee timer
+esp_err_t lcd_marquee_start(lcd_marquee_t* marquee, i2c_lcd_pcf8574_handle_t* lcd) {
+    memset(marquee, 0, sizeof(*marquee));
+    marquee->lcd = lcd;
+    portMUX_INITIALIZE(&marquee->lock);
+
+    const esp_timer_create_args_t args = {
+        .callback = lcd_marquee_tick,
+        .arg = marquee,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "lcd_marquee",
+    };
+    return esp_timer_create(&args, &marquee->timer);
+}  // lcd_marquee_start()
+
+// Hand a new text to the timer and wake it up to draw it
+esp_err_t lcd_marquee_set_text(lcd_marquee_t* marquee, uint8_t row, const char* text, uint32_t interval_ms) {
+    LCD_NO_ALLOC_SCOPE(marquee->lcd);
+    ESP_RETURN_ON_FALSE(marquee->timer != NULL, ESP_ERR_INVALID_STATE, TAG, "Marquee is not running");
+    ESP_RETURN_ON_FALSE(row < marquee->lcd->lines, ESP_ERR_INVALID_ARG, TAG, "Row %d is outside the display", row);
+    ESP_RETURN_ON_FALSE(interval_ms > 0 || text == NULL || strlen(text) <= marquee->lcd->cols, ESP_ERR_INVALID_ARG, TAG,
+                        "A scrolling text needs an interval");
+
+    portENTER_CRITICAL(&marquee->lock);
+    if (marquee->stopping) {
+        portEXIT_CRITICAL(&marquee->lock);
+        ESP_LOGE(TAG, "Marquee is stopping");
+        return ESP_ERR_INVALID_STATE;
+    }
+    marquee->rows[row].next_text = text;
+    marquee->rows[row].next_interval_ms = interval_ms;
+    marquee->rows[row].changed = true;
+    esp_timer_stop(marquee->timer);
+    esp_err_t ret = esp_timer_start_once(marquee->timer, 0);
+    portEXIT_CRITICAL(&marquee->lock);
+    return ret;
+}  // lcd_marquee_set_text()
+
+// Stop the timer and wait for a step that runs already, then return home: the flush puts what the
+// framebuffer holds at shift 0
+esp_err_t lcd_marquee_stop(lcd_marquee_t* marquee) {
+    LCD_NO_ALLOC_SCOPE(marquee->lcd);
+    ESP_RETURN_ON_FALSE(marquee->timer != NULL, ESP_ERR_INVALID_STATE, TAG, "Marquee is not running");
+
+    portENTER_CRITICAL(&marquee->lock);
+    marquee->stopping = true;
+    // Fails if the timer is not armed, a step that runs doesn't arm it anymore
+    esp_timer_stop(marquee->timer);
+    portEXIT_CRITICAL(&marquee->lock);
+    // esp_timer_stop() doesn't wait for the callback
+    while (marquee->ticking) {
+        vTaskDelay(1);
+    }
+    ESP_RETURN_ON_ERROR(esp_timer_delete(marquee->timer), TAG, "Failed to delete the marquee timer");
+    marquee->timer = NULL;
+
+    if (marquee->shift != 0 || marquee->resync) {
+        LCD_RETURN_ON_ERROR(lcd_home(marquee->lcd));
+        marquee->shift = 0;
+    }
+    return lcd_flush(marquee->lcd);
+}  // lcd_marquee_stop()
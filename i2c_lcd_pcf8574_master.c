@@ -0,0 +1,191 @@
+/// \file i2c_lcd_pcf8574_master.c
+/// \brief Transport of the i2c_lcd_pcf8574 driver through the I2C master driver of ESP-IDF 5.2+
+///
+/// The bus and the device are set up by the application with i2c_new_master_bus() and
+/// i2c_master_bus_add_device(), the device's scl_speed_hz sets the clock of the display.
+///
+/// On a bus with a trans_queue_depth the driver queues transactions and returns right away,
+/// the device's on_trans_done callback reports them done in order. The asynchronous transport
+/// keeps the completions of up to LCD_MASTER_ASYNC_DEPTH queued transactions: streamed frames
+/// call back their owner, the writes of the rest of the API wait on a semaphore. A write whose
+/// caller timed out stays queued until the driver is done with it, it holds the next one back.
+///
+/// \author Femi Olugbon, https://iamflinks.github.io
+/// \copyright Copyright (c) 2024 by Femi Olugbon
+///
+/// ChangeLog see: i2c_lcd_pcf8574.h
+
+#include "sdkconfig.h"
+
+#if CONFIG_LCD_PCF8574_I2C_MASTER
+
+#include <stdint.h>
+#include <string.h>
+#include "i2c_lcd_pcf8574.h"
+#include "esp_check.h"
+#include "esp_rom_sys.h"
+
+
+#define TAG "I2C_LCD_PCF8574"
+
+static esp_err_t lcd_master_write(void* ctx, const uint8_t* bytes, size_t len, uint32_t timeout_ms) {
+    return i2c_master_transmit((i2c_master_dev_handle_t)ctx, bytes, len, timeout_ms);
+}  // lcd_master_write()
+
+static esp_err_t lcd_master_write_read(void* ctx, const uint8_t* bytes, size_t len, uint8_t* rx, size_t rx_len,
+                                       uint32_t timeout_ms) {
+    return i2c_master_transmit_receive((i2c_master_dev_handle_t)ctx, bytes, len, rx, rx_len, timeout_ms);
+}  // lcd_master_write_read()
+
+static void lcd_master_delay_us(void* ctx, uint32_t us) {
+    esp_rom_delay_us(us);
+}  // lcd_master_delay_us()
+
+// Transport through a device of the I2C master driver
+void lcd_transport_i2c_master(lcd_transport_t* transport, i2c_master_dev_handle_t dev) {
+    transport->write = lcd_master_write;
+    transport->write_read = lcd_master_write_read;
+    transport->delay_us = lcd_master_delay_us;
+    transport->write_async = NULL;
+    transport->ctx = dev;
+}  // lcd_transport_i2c_master()
+
+// Note the completion of a transaction before it is queued, the callback may come before
+// i2c_master_transmit() returns
+static esp_err_t lcd_master_async_push(lcd_master_async_t* async, lcd_transport_done_t done, void* arg) {
+    esp_err_t ret = ESP_OK;
+
+    portENTER_CRITICAL(&async->lock);
+    if (async->count < LCD_MASTER_ASYNC_DEPTH) {
+        uint8_t slot = (async->head + async->count) % LCD_MASTER_ASYNC_DEPTH;
+        async->pending[slot].done = done;
+        async->pending[slot].arg = arg;
+        async->count++;
+    } else {
+        ret = ESP_ERR_NOT_FINISHED;
+    }
+    portEXIT_CRITICAL(&async->lock);
+    return ret;
+}  // lcd_master_async_push()
+
+// The transaction was not queued after all: it is the last one noted
+static void lcd_master_async_drop(lcd_master_async_t* async) {
+    portENTER_CRITICAL(&async->lock);
+    async->count--;
+    portEXIT_CRITICAL(&async->lock);
+}  // lcd_master_async_drop()
+
+// on_trans_done of the device, called from the I2C interrupt
+static bool lcd_master_async_done(i2c_master_dev_handle_t dev, const i2c_master_event_data_t* evt_data, void* arg) {
+    lcd_master_async_t* async = arg;
+    const esp_err_t err = (evt_data->event == I2C_EVENT_DONE) ? ESP_OK : ESP_FAIL;
+    lcd_transport_done_t done = NULL;
+    void* done_arg = NULL;
+    bool found = false;
+    BaseType_t woken = pdFALSE;
+
+    portENTER_CRITICAL_ISR(&async->lock);
+    if (async->count > 0) {
+        done = async->pending[async->head].done;
+        done_arg = async->pending[async->head].arg;
+        async->head = (async->head + 1) % LCD_MASTER_ASYNC_DEPTH;
+        async->count--;
+        found = true;
+    }
+    portEXIT_CRITICAL_ISR(&async->lock);
+
+    if (!found) {
+        return false;
+    }
+    if (done != NULL) {
+        done(done_arg, err);
+    } else {
+        async->sync_err = err;
+        xSemaphoreGiveFromISR(async->sync, &woken);
+    }
+    return woken == pdTRUE;
+}  // lcd_master_async_done()
+
+// Queue a transaction the caller waits for. The bytes and the read-back go through buffers of
+// async: after a timeout the driver still owns them, so the next call first waits for that
+// transaction to finish and takes its completion before they are reused.
+static esp_err_t lcd_master_async_sync(lcd_master_async_t* async, const uint8_t* bytes, size_t len,
+                                       uint8_t* rx, size_t rx_len, uint32_t timeout_ms) {
+    ESP_RETURN_ON_FALSE(len <= sizeof(async->sync_tx) && rx_len <= sizeof(async->sync_rx), ESP_ERR_INVALID_SIZE, TAG,
+                        "Transaction too long");
+    // Frames queued before this one go first
+    TickType_t ticks = pdMS_TO_TICKS(timeout_ms * LCD_MASTER_ASYNC_DEPTH);
+    if (ticks == 0) {
+        ticks = 1;
+    }
+    if (async->sync_abandoned) {
+        ESP_RETURN_ON_FALSE(xSemaphoreTake(async->sync, ticks) == pdTRUE, ESP_ERR_TIMEOUT, TAG,
+                            "An earlier transaction is still queued");
+        async->sync_abandoned = false;
+    }
+    memcpy(async->sync_tx, bytes, len);
+
+    ESP_RETURN_ON_ERROR(lcd_master_async_push(async, NULL, NULL), TAG, "Too many transactions queued");
+    esp_err_t ret = (rx_len > 0)
+        ? i2c_master_transmit_receive(async->dev, async->sync_tx, len, async->sync_rx, rx_len, timeout_ms)
+        : i2c_master_transmit(async->dev, async->sync_tx, len, timeout_ms);
+    if (ret != ESP_OK) {
+        lcd_master_async_drop(async);
+        return ret;
+    }
+    if (xSemaphoreTake(async->sync, ticks) != pdTRUE) {
+        async->sync_abandoned = true;
+        return ESP_ERR_TIMEOUT;
+    }
+    if (async->sync_err == ESP_OK && rx_len > 0) {
+        memcpy(rx, async->sync_rx, rx_len);
+    }
+    return async->sync_err;
+}  // lcd_master_async_sync()
+
+static esp_err_t lcd_master_async_write(void* ctx, const uint8_t* bytes, size_t len, uint32_t timeout_ms) {
+    return lcd_master_async_sync(ctx, bytes, len, NULL, 0, timeout_ms);
+}  // lcd_master_async_write()
+
+static esp_err_t lcd_master_async_write_read(void* ctx, const uint8_t* bytes, size_t len, uint8_t* rx, size_t rx_len,
+                                             uint32_t timeout_ms) {
+    return lcd_master_async_sync(ctx, bytes, len, rx, rx_len, timeout_ms);
+}  // lcd_master_async_write_read()
+
+static esp_err_t lcd_master_async_write_async(void* ctx, const uint8_t* bytes, size_t len, uint32_t timeout_ms,
+                                              lcd_transport_done_t done, void* arg) {
+    lcd_master_async_t* async = ctx;
+
+    ESP_RETURN_ON_ERROR(lcd_master_async_push(async, done, arg), TAG, "Too many transactions queued");
+    esp_err_t ret = i2c_master_transmit(async->dev, bytes, len, timeout_ms);
+    if (ret != ESP_OK) {
+        lcd_master_async_drop(async);
+    }
+    return ret;
+}  // lcd_master_async_write_async()
+
+// Transport through a device on a master bus in asynchronous mode
+esp_err_t lcd_transport_i2c_master_async(lcd_transport_t* transport, lcd_master_async_t* async, i2c_master_dev_handle_t dev) {
+    const i2c_master_event_callbacks_t callbacks = {
+        .on_trans_done = lcd_master_async_done,
+    };
+
+    async->dev = dev;
+    async->head = 0;
+    async->count = 0;
+    async->sync_err = ESP_OK;
+    async->sync_abandoned = false;
+    async->sync = xSemaphoreCreateBinaryStatic(&async->sync_buf);
+    portMUX_INITIALIZE(&async->lock);
+    ESP_RETURN_ON_ERROR(i2c_master_register_event_callbacks(dev, &callbacks, async), TAG,
+                        "Failed to register the completion callback, is trans_queue_depth set?");
+
+    transport->write = lcd_master_async_write;
+    transport->write_read = lcd_master_async_write_read;
+    transport->delay_us = lcd_master_delay_us;
+    transport->write_async = lcd_master_async_write_async;
+    transport->ctx = async;
+    return ESP_OK;
+}  // lcd_transport_i2c_master_async()
+
+#endif  // CONFIG_LCD_PCF8574_I2C_MASTER
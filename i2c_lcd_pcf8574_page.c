@@ -0,0 +1,94 @@
+/// \file i2c_lcd_pcf8574_page.c
+/// \brief Page flipping through the off-screen DDRAM for the i2c_lcd_pcf8574 driver
+///
+/// A DDRAM line holds 40 characters, a 16x2 display shows 16 of them. The columns after the
+/// visible ones form a second page: the next screen is drawn there while the current one stays
+/// visible, then display shift instructions move the window over in one short transaction.
+///
+/// \author Femi Olugbon, https://iamflinks.github.io
+/// \copyright Copyright (c) 2024 by Femi Olugbon
+///
+/// ChangeLog see: i2c_lcd_pcf8574.h
+
+#include <stdint.h>
+#include "i2c_lcd_pcf8574.h"
+#include "i2c_lcd_pcf8574_priv.h"
+#include "esp_log.h"
+#include "esp_check.h"
+
+
+#define TAG "I2C_LCD_PCF8574"
+
+// Characters in one DDRAM line of a 2-line display
+#define LCD_DDRAM_LINE 40
+
+
+// Point the row offsets at a page: everything addressed by row and column goes there
+static void lcd_page_select(i2c_lcd_pcf8574_handle_t* lcd, uint8_t page) {
+    lcd->row_offsets[0] = 0x00 + page * lcd->cols;
+    lcd->row_offsets[1] = 0x40 + page * lcd->cols;
+}  // lcd_page_select()
+
+// Return home and clear display set the display shift back to 0, so page 0 is shown again.
+// If the instruction failed the shift stays unknown until the next flip returns home.
+void lcd_page_reset(i2c_lcd_pcf8574_handle_t* lcd) {
+    lcd->page_lost = lcd->bus_err != ESP_OK;
+    if (lcd->page == 0) {
+        return;
+    }
+    // The pages swap roles, a partly flushed page counts as unknown
+    const bool shown_known = lcd->ddram_valid;
+    lcd->ddram_valid = !lcd->page_stale;
+    lcd->flush_resync = 0;
+    lcd->page_stale = !shown_known;
+    lcd->page = 0;
+    lcd_page_select(lcd, 0);
+}  // lcd_page_reset()
+
+// Draw the framebuffer on the hidden page and show it. The drawing and the display shifts go out
+// in one batch, so the visible change takes one transaction of a few hundred microseconds.
+esp_err_t lcd_page_flip(i2c_lcd_pcf8574_handle_t* lcd) {
+    LCD_NO_ALLOC_SCOPE(lcd);
+    ESP_RETURN_ON_FALSE(lcd->lines <= 2 && lcd->cols * 2 <= LCD_DDRAM_LINE, ESP_ERR_NOT_SUPPORTED, TAG,
+                        "No off-screen page on a %dx%d display", lcd->cols, lcd->lines);
+    if (lcd->page_lost) {
+        // A failed flip left the display shift unknown: start over from page 0
+        LCD_RETURN_ON_ERROR(lcd_home(lcd));
+    }
+
+    const uint8_t shown = lcd->page;
+    const bool shown_known = lcd->ddram_valid;
+
+    // The hidden page still holds the screen before the current one, only the differences are sent
+    lcd_page_select(lcd, !shown);
+    lcd->ddram_valid = !lcd->page_stale;
+    lcd->flush_resync = 0;
+
+    lcd_batch_begin(lcd);
+    lcd_flush(lcd);
+    if (shown == 0) {
+        for (uint8_t i = 0; i < lcd->cols; i++) {
+            // Instruction: Cursor or display shift = 0x10, shift the display left = 0x08
+            lcd_send(lcd, 0x18, false);
+        }
+    } else {
+        // Instruction: Return home = 0x02, one instruction instead of cols shifts right
+        lcd_send(lcd, 0x02, false);
+    }
+    esp_err_t ret = lcd_batch_commit(lcd);
+    if (shown != 0) {
+        // Same as lcd_home(): takes approx. 1.5ms
+        lcd_set_busy(lcd, 1600);
+    }
+
+    if (ret != ESP_OK) {
+        // Some of the shifts may have happened: the next flip returns home first. A display
+        // recovered by the circuit breaker is back on page 0 already.
+        lcd_page_select(lcd, lcd->page);
+        lcd->page_lost = true;
+        return ret;
+    }
+    lcd->page = !shown;
+    lcd->page_stale = !shown_known;
+    return ESP_OK;
+}  // lcd_page_flip()
@@ -0,0 +1,93 @@
+/// \file i2c_lcd_pcf8574_perf.c
+/// \brief Performance counters of the i2c_lcd_pcf8574 driver
+///
+/// \author Femi Olugbon, https://iamflinks.github.io
+/// \copyright Copyright (c) 2024 by Femi Olugbon
+///
+/// ChangeLog see: i2c_lcd_pcf8574.h
+
+#include <string.h>
+#include "sdkconfig.h"
+#include "i2c_lcd_pcf8574.h"
+#include "i2c_lcd_pcf8574_priv.h"
+
+
+// Upper limit of the first latency bucket as a power of two: 64us
+#define LCD_PERF_LATENCY_MIN_LOG2 6
+
+#if CONFIG_LCD_PCF8574_PERF_COUNTERS
+
+// Latency bucket of a transaction duration
+static uint8_t lcd_perf_bucket(uint32_t us) {
+    if (us < (1u << LCD_PERF_LATENCY_MIN_LOG2)) {
+        return 0;
+    }
+    int bucket = (31 - __builtin_clz(us)) - LCD_PERF_LATENCY_MIN_LOG2 + 1;
+    return (bucket < LCD_PERF_LATENCY_BUCKETS) ? bucket : LCD_PERF_LATENCY_BUCKETS - 1;
+}  // lcd_perf_bucket()
+
+// Count a failed transaction under its error code
+static void lcd_perf_error(lcd_perf_t* perf, esp_err_t err) {
+    perf->errors++;
+    for (int i = 0; i < LCD_PERF_ERROR_CODES; i++) {
+        if (perf->error_codes[i].count == 0) {
+            perf->error_codes[i].code = err;
+        }
+        if (perf->error_codes[i].code == err) {
+            perf->error_codes[i].count++;
+            return;
+        }
+    }
+    perf->errors_other++;
+}  // lcd_perf_error()
+
+// Count one finished I2C transaction
+void lcd_perf_transfer(i2c_lcd_pcf8574_handle_t* lcd, size_t bytes, int64_t duration_us, esp_err_t err) {
+    uint32_t us = (duration_us > 0) ? (uint32_t)duration_us : 0;
+
+    portENTER_CRITICAL(&lcd->perf_lock);
+    lcd->perf.transactions++;
+    lcd->perf.bytes += bytes;
+    lcd->perf.bus_us += us;
+    lcd->perf.latency[lcd_perf_bucket(us)]++;
+    if (us > lcd->perf.latency_max_us) {
+        lcd->perf.latency_max_us = us;
+    }
+    if (err != ESP_OK) {
+        lcd_perf_error(&lcd->perf, err);
+    }
+    portEXIT_CRITICAL(&lcd->perf_lock);
+}  // lcd_perf_transfer()
+
+// Count time spent waiting for the controller, spinning or sleeping
+void lcd_perf_wait(i2c_lcd_pcf8574_handle_t* lcd, int64_t duration_us, bool sleeping) {
+    portENTER_CRITICAL(&lcd->perf_lock);
+    if (sleeping) {
+        lcd->perf.sleep_us += duration_us;
+    } else {
+        lcd->perf.delay_us += duration_us;
+    }
+    portEXIT_CRITICAL(&lcd->perf_lock);
+}  // lcd_perf_wait()
+
+#endif
+
+// Take a snapshot of the performance counters
+void lcd_perf_get(i2c_lcd_pcf8574_handle_t* lcd, lcd_perf_t* perf) {
+#if CONFIG_LCD_PCF8574_PERF_COUNTERS
+    portENTER_CRITICAL(&lcd->perf_lock);
+    *perf = lcd->perf;
+    portEXIT_CRITICAL(&lcd->perf_lock);
+#else
+    memset(perf, 0, sizeof(*perf));
+#endif
+}  // lcd_perf_get()
+
+// Reset the performance counters
+void lcd_perf_reset(i2c_lcd_pcf8574_handle_t* lcd) {
+#if CONFIG_LCD_PCF8574_PERF_COUNTERS
+    portENTER_CRITICAL(&lcd->perf_lock);
+    memset(&lcd->perf, 0, sizeof(lcd->perf));
+    portEXIT_CRITICAL(&lcd->perf_lock);
+#endif
+}  // lcd_perf_reset()
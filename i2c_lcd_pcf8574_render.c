@@ -0,0 +1,276 @@
+/// \file i2c_lcd_pcf8574_render.c
+/// \brief Optional render task for the i2c_lcd_pcf8574 driver
+///
+/// \author Femi Olugbon, https://iamflinks.github.io
+/// \copyright Copyright (c) 2024 by Femi Olugbon
+///
+/// ChangeLog see: i2c_lcd_pcf8574.h
+
+#include <stdlib.h>
+#include <string.h>
+#include "i2c_lcd_pcf8574.h"
+#include "i2c_lcd_pcf8574_priv.h"
+#include "esp_log.h"
+#include "esp_check.h"
+
+
+#define TAG "I2C_LCD_PCF8574"
+
+// Most updates the task takes from the queue before it flushes the framebuffer
+#define LCD_RENDER_DRAIN_MAX 16
+
+typedef enum {
+    LCD_RENDER_TEXT,
+    LCD_RENDER_CLEAR,
+} lcd_render_kind_t;
+
+typedef struct lcd_render_update {
+    uint8_t kind;
+    uint8_t col;
+    uint8_t row;
+    uint8_t len;
+    uint8_t text[LCD_RENDER_TEXT_MAX];
+} lcd_render_update_t;
+
+
+// Remove the queued update at index i
+static void lcd_render_remove(i2c_lcd_pcf8574_handle_t* lcd, uint8_t i) {
+    memmove(&lcd->render_queue[i], &lcd->render_queue[i + 1], (lcd->render_queued - i - 1) * sizeof(lcd_render_update_t));
+    lcd->render_queued--;
+}  // lcd_render_remove()
+
+// Queue text, under render_lock. The newest queued text on the same row that overlaps or touches
+// the new one takes it in, unless the two together are too long; other queued texts the new one
+// covers completely are removed. A queued clear always stays, it is the first update if there is one.
+static esp_err_t lcd_render_queue_text(i2c_lcd_pcf8574_handle_t* lcd, const lcd_render_update_t* update) {
+    const int end = update->col + update->len;
+    int merged = -1;
+
+    for (int i = lcd->render_queued - 1; i >= 0; i--) {
+        lcd_render_update_t* queued = &lcd->render_queue[i];
+        const int queued_end = queued->col + queued->len;
+        if (queued->kind == LCD_RENDER_CLEAR) {
+            break;
+        }
+        if (queued->row != update->row || queued->col > end || update->col > queued_end) {
+            continue;
+        }
+        const int merged_col = (queued->col < update->col) ? queued->col : update->col;
+        const int merged_end = (queued_end > end) ? queued_end : end;
+        if (merged_end - merged_col > LCD_RENDER_TEXT_MAX) {
+            break;
+        }
+        memmove(&queued->text[queued->col - merged_col], queued->text, queued->len);
+        memcpy(&queued->text[update->col - merged_col], update->text, update->len);
+        queued->col = merged_col;
+        queued->len = merged_end - merged_col;
+        merged = i;
+        lcd->render_stats.coalesced++;
+        break;
+    }
+
+    // Queued texts before the merged one (or all, if there is none) that the new text covers
+    for (int i = (merged >= 0 ? merged : lcd->render_queued) - 1; i >= 0; i--) {
+        const lcd_render_update_t* queued = &lcd->render_queue[i];
+        if (queued->kind == LCD_RENDER_TEXT && queued->row == update->row && queued->col >= update->col &&
+            queued->col + queued->len <= end) {
+            lcd_render_remove(lcd, i);
+            lcd->render_stats.coalesced++;
+        }
+    }
+    if (merged >= 0) {
+        return ESP_OK;
+    }
+    if (lcd->render_queued == lcd->render_queue_len) {
+        return ESP_ERR_NO_MEM;
+    }
+    lcd->render_queue[lcd->render_queued++] = *update;
+    return ESP_OK;
+}  // lcd_render_queue_text()
+
+// Queue a clear, under render_lock: everything queued before it would be cleared anyway
+static esp_err_t lcd_render_queue_clear(i2c_lcd_pcf8574_handle_t* lcd, const lcd_render_update_t* update) {
+    lcd->render_stats.coalesced += lcd->render_queued;
+    lcd->render_queue[0] = *update;
+    lcd->render_queued = 1;
+    return ESP_OK;
+}  // lcd_render_queue_clear()
+
+// Draw an update into the framebuffer
+static void lcd_render_apply(i2c_lcd_pcf8574_handle_t* lcd, const lcd_render_update_t* update) {
+    if (update->kind == LCD_RENDER_CLEAR) {
+        lcd_fb_clear(lcd);
+        return;
+    }
+    for (uint8_t k = 0; k < update->len; k++) {
+        lcd_fb_write(lcd, update->col + k, update->row, update->text[k]);
+    }
+}  // lcd_render_apply()
+
+// The render task: when woken, take what is queued and flush once every LCD_RENDER_DRAIN_MAX
+// updates. Ends when lcd_render_stop() was called and the queue is empty.
+static void lcd_render_task(void* arg) {
+    i2c_lcd_pcf8574_handle_t* lcd = (i2c_lcd_pcf8574_handle_t*)arg;
+    lcd_render_update_t update;
+    bool stop = false;
+
+    while (!stop) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        LCD_NO_ALLOC_SCOPE(lcd);
+        int taken = LCD_RENDER_DRAIN_MAX;
+        while (taken == LCD_RENDER_DRAIN_MAX) {
+            for (taken = 0; taken < LCD_RENDER_DRAIN_MAX; taken++) {
+                portENTER_CRITICAL(&lcd->render_lock);
+                const bool empty = lcd->render_queued == 0;
+                if (empty) {
+                    stop = lcd->render_stopping;
+                } else {
+                    update = lcd->render_queue[0];
+                    lcd_render_remove(lcd, 0);
+                }
+                portEXIT_CRITICAL(&lcd->render_lock);
+                if (empty) {
+                    break;
+                }
+                lcd_render_apply(lcd, &update);
+            }
+            if (taken == 0) {
+                continue;
+            }
+            esp_err_t ret = lcd_flush(lcd);
+            portENTER_CRITICAL(&lcd->render_lock);
+            lcd->render_stats.flushes++;
+            if (ret != ESP_OK) {
+                lcd->render_stats.flush_errors++;
+                lcd->render_stats.last_error = ret;
+            }
+            portEXIT_CRITICAL(&lcd->render_lock);
+        }
+    }
+
+    lcd->render_running = false;
+    vTaskDelete(NULL);
+}  // lcd_render_task()
+
+// Queue an update and wake the task. Updates for different regions than the queued ones are
+// refused when the queue is full; clears always get in.
+static esp_err_t lcd_render_enqueue(i2c_lcd_pcf8574_handle_t* lcd, const lcd_render_update_t* update) {
+    portENTER_CRITICAL(&lcd->render_lock);
+    if (lcd->render_queue == NULL || lcd->render_stopping) {
+        portEXIT_CRITICAL(&lcd->render_lock);
+        ESP_LOGE(TAG, "Render task is not running");
+        return ESP_ERR_INVALID_STATE;
+    }
+    esp_err_t ret = (update->kind == LCD_RENDER_CLEAR) ? lcd_render_queue_clear(lcd, update)
+                                                       : lcd_render_queue_text(lcd, update);
+    if (ret == ESP_OK) {
+        lcd->render_stats.posted++;
+    } else {
+        lcd->render_stats.dropped++;
+    }
+    // lcd_render_stop() waits for this post to be done with the task
+    TaskHandle_t task = lcd->render_task;
+    lcd->render_posting++;
+    portEXIT_CRITICAL(&lcd->render_lock);
+
+    if (ret == ESP_OK) {
+        xTaskNotifyGive(task);
+    }
+    portENTER_CRITICAL(&lcd->render_lock);
+    lcd->render_posting--;
+    portEXIT_CRITICAL(&lcd->render_lock);
+    return ret;
+}  // lcd_render_enqueue()
+
+// Start the render task
+esp_err_t lcd_render_start(i2c_lcd_pcf8574_handle_t* lcd, const lcd_render_config_t* config) {
+    ESP_RETURN_ON_FALSE(config != NULL && config->queue_len > 0, ESP_ERR_INVALID_ARG, TAG, "Invalid render config");
+    ESP_RETURN_ON_FALSE(lcd->render_queue == NULL, ESP_ERR_INVALID_STATE, TAG, "Render task already running");
+
+    lcd_render_update_t* queue = calloc(config->queue_len, sizeof(lcd_render_update_t));
+    ESP_RETURN_ON_FALSE(queue != NULL, ESP_ERR_NO_MEM, TAG, "No memory for the render queue");
+
+    memset(&lcd->render_stats, 0, sizeof(lcd->render_stats));
+    lcd->render_queue_len = config->queue_len;
+    lcd->render_queued = 0;
+    lcd->render_stopping = false;
+    lcd->render_running = true;
+    if (xTaskCreatePinnedToCore(lcd_render_task, "lcd_render", config->stack_size, lcd,
+                                config->priority, &lcd->render_task, config->core_id) != pdPASS) {
+        lcd->render_running = false;
+        lcd->render_task = NULL;
+        free(queue);
+        ESP_LOGE(TAG, "Failed to create the render task");
+        return ESP_ERR_NO_MEM;
+    }
+    // Posts are accepted from here on
+    portENTER_CRITICAL(&lcd->render_lock);
+    lcd->render_queue = queue;
+    portEXIT_CRITICAL(&lcd->render_lock);
+    return ESP_OK;
+}  // lcd_render_start()
+
+// Stop the render task: new posts are refused, the queued updates are drawn first
+void lcd_render_stop(i2c_lcd_pcf8574_handle_t* lcd) {
+    LCD_NO_ALLOC_SCOPE(lcd);
+    portENTER_CRITICAL(&lcd->render_lock);
+    const bool running = lcd->render_queue != NULL && !lcd->render_stopping;
+    lcd->render_stopping = running || lcd->render_stopping;
+    portEXIT_CRITICAL(&lcd->render_lock);
+    if (!running) {
+        return;
+    }
+
+    // Posts that got in before the flag was set may still be waking the task
+    for (;;) {
+        portENTER_CRITICAL(&lcd->render_lock);
+        const bool posting = lcd->render_posting > 0;
+        portEXIT_CRITICAL(&lcd->render_lock);
+        if (!posting) {
+            break;
+        }
+        vTaskDelay(1);
+    }
+    xTaskNotifyGive(lcd->render_task);
+    while (lcd->render_running) {
+        vTaskDelay(1);
+    }
+
+    portENTER_CRITICAL(&lcd->render_lock);
+    lcd_render_update_t* queue = lcd->render_queue;
+    lcd->render_queue = NULL;
+    lcd->render_queued = 0;
+    lcd->render_task = NULL;
+    lcd->render_stopping = false;
+    portEXIT_CRITICAL(&lcd->render_lock);
+    free(queue);
+}  // lcd_render_stop()
+
+// Queue text for the render task
+esp_err_t lcd_render_post(i2c_lcd_pcf8574_handle_t* lcd, uint8_t col, uint8_t row, const char* str) {
+    LCD_NO_ALLOC_SCOPE(lcd);
+    lcd_render_update_t update = { .kind = LCD_RENDER_TEXT, .col = col, .row = row };
+    size_t len = strlen(str);
+    if (len > LCD_RENDER_TEXT_MAX) {
+        ESP_LOGW(TAG, "Render text truncated to %d characters", LCD_RENDER_TEXT_MAX);
+        len = LCD_RENDER_TEXT_MAX;
+    }
+    update.len = len;
+    memcpy(update.text, str, len);
+    return lcd_render_enqueue(lcd, &update);
+}  // lcd_render_post()
+
+// Queue a clear of the whole screen
+esp_err_t lcd_render_post_clear(i2c_lcd_pcf8574_handle_t* lcd) {
+    LCD_NO_ALLOC_SCOPE(lcd);
+    lcd_render_update_t update = { .kind = LCD_RENDER_CLEAR };
+    return lcd_render_enqueue(lcd, &update);
+}  // lcd_render_post_clear()
+
+// Copy the render task statistics
+void lcd_render_get_stats(i2c_lcd_pcf8574_handle_t* lcd, lcd_render_stats_t* stats) {
+    portENTER_CRITICAL(&lcd->render_lock);
+    *stats = lcd->render_stats;
+    stats->queue_depth = lcd->render_queued;
+    portEXIT_CRITICAL(&lcd->render_lock);
+}  // lcd_render_get_stats()
@@ -0,0 +1,94 @@
+/// \file i2c_lcd_pcf8574_ring.c
+/// \brief Lock-free multi-producer write ring for the i2c_lcd_pcf8574 driver
+///
+/// \author Femi Olugbon, https://iamflinks.github.io
+/// \copyright Copyright (c) 2024 by Femi Olugbon
+///
+/// ChangeLog see: i2c_lcd_pcf8574.h
+///
+/// Bounded MPSC queue after D. Vyukov: every slot carries a sequence number. A producer owns a slot
+/// once it moved `head` past it with a compare-and-swap, and publishes it by setting the sequence
+/// to position + 1. The consumer hands the slot back with position + LCD_RING_SIZE.
+
+#include <string.h>
+#include "i2c_lcd_pcf8574.h"
+#include "i2c_lcd_pcf8574_priv.h"
+#include "esp_log.h"
+#include "esp_check.h"
+
+
+#define TAG "I2C_LCD_PCF8574"
+
+#define LCD_RING_MASK (LCD_RING_SIZE - 1)
+
+_Static_assert((LCD_RING_SIZE & LCD_RING_MASK) == 0, "LCD_RING_SIZE must be a power of two");
+
+
+// Attach a ring to the handle
+void lcd_ring_attach(i2c_lcd_pcf8574_handle_t* lcd, lcd_write_ring_t* ring) {
+    memset(ring, 0, sizeof(*ring));
+    for (uint32_t i = 0; i < LCD_RING_SIZE; i++) {
+        ring->slots[i].seq = i;
+    }
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    lcd->ring = ring;
+}  // lcd_ring_attach()
+
+// Queue a positioned write: safe from any number of tasks on both cores, never blocks
+esp_err_t lcd_ring_post(i2c_lcd_pcf8574_handle_t* lcd, uint8_t col, uint8_t row, const char* str) {
+    lcd_write_ring_t* ring = lcd->ring;
+    ESP_RETURN_ON_FALSE(ring != NULL, ESP_ERR_INVALID_STATE, TAG, "No write ring attached");
+
+    lcd_ring_slot_t* slot;
+    uint32_t pos = __atomic_load_n(&ring->head, __ATOMIC_RELAXED);
+    for (;;) {
+        slot = &ring->slots[pos & LCD_RING_MASK];
+        uint32_t seq = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+        int32_t diff = (int32_t)(seq - pos);
+        if (diff == 0) {
+            // The slot is free: claim it, or retry with the position another producer left
+            if (__atomic_compare_exchange_n(&ring->head, &pos, pos + 1, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                break;
+            }
+        } else if (diff < 0) {
+            // The consumer has not read this slot yet: the ring is full
+            __atomic_fetch_add(&ring->dropped, 1, __ATOMIC_RELAXED);
+            return ESP_ERR_NO_MEM;
+        } else {
+            pos = __atomic_load_n(&ring->head, __ATOMIC_RELAXED);
+        }
+    }
+
+    size_t len = strlen(str);
+    slot->col = col;
+    slot->row = row;
+    slot->len = (len > LCD_RING_TEXT_MAX) ? LCD_RING_TEXT_MAX : len;
+    memcpy(slot->text, str, slot->len);
+    __atomic_store_n(&slot->seq, pos + 1, __ATOMIC_RELEASE);
+    return ESP_OK;
+}  // lcd_ring_post()
+
+// Apply the published writes in order, then flush once. Only one task may drain a ring.
+esp_err_t lcd_ring_drain(i2c_lcd_pcf8574_handle_t* lcd, size_t* applied_out) {
+    LCD_NO_ALLOC_SCOPE(lcd);
+    lcd_write_ring_t* ring = lcd->ring;
+    ESP_RETURN_ON_FALSE(ring != NULL, ESP_ERR_INVALID_STATE, TAG, "No write ring attached");
+
+    size_t applied = 0;
+    for (;;) {
+        lcd_ring_slot_t* slot = &ring->slots[ring->tail & LCD_RING_MASK];
+        if (__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) != ring->tail + 1) {
+            break;
+        }
+        for (uint8_t i = 0; i < slot->len; i++) {
+            lcd_fb_write(lcd, slot->col + i, slot->row, slot->text[i]);
+        }
+        __atomic_store_n(&slot->seq, ring->tail + LCD_RING_SIZE, __ATOMIC_RELEASE);
+        ring->tail++;
+        applied++;
+    }
+    if (applied_out != NULL) {
+        *applied_out = applied;
+    }
+    return (applied > 0) ? lcd_flush(lcd) : ESP_OK;
+}  // lcd_ring_drain()
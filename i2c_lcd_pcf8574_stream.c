@@ -0,0 +1,201 @@
+/// \file i2c_lcd_pcf8574_stream.c
+/// \brief Frame streaming for the i2c_lcd_pcf8574 driver
+///
+/// A frame is what lcd_flush() would send, encoded into one of two wire buffers instead of going
+/// on the bus: while the transport shifts one frame out, the next one is encoded into the other.
+/// Encoding runs lcd_flush() against a transport that appends to the frame, so the DDRAM mirror,
+/// the cursor model and the skipped commands stay the same as for direct flushes.
+///
+/// \author Femi Olugbon, https://iamflinks.github.io
+/// \copyright Copyright (c) 2024 by Femi Olugbon
+///
+/// ChangeLog see: i2c_lcd_pcf8574.h
+
+#include <stdint.h>
+#include <string.h>
+#include "i2c_lcd_pcf8574.h"
+#include "i2c_lcd_pcf8574_priv.h"
+#include "esp_log.h"
+#include "esp_check.h"
+
+
+#define TAG "I2C_LCD_PCF8574"
+
+
+// Append a transaction to the frame being encoded. Behind a 16-bit expander every transaction
+// starts with the same register byte, the frame keeps only the first one.
+static esp_err_t lcd_stream_append(void* ctx, const uint8_t* bytes, size_t len, uint32_t timeout_ms) {
+    lcd_stream_t* stream = ctx;
+    uint8_t* frame = stream->frames[stream->next];
+
+    if (LCD_EXPANDER_8BIT(stream->lcd) && stream->len > 0) {
+        bytes++;
+        len--;
+    }
+    if (stream->len + len > sizeof(stream->frames[0])) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    memcpy(&frame[stream->len], bytes, len);
+    stream->len += len;
+    return ESP_OK;
+}  // lcd_stream_append()
+
+// Frames only hold data writes and addresses, the controller is never busy for long inside one
+static void lcd_stream_no_delay(void* ctx, uint32_t us) {
+}  // lcd_stream_no_delay()
+
+// A frame is out. The result of an asynchronous one is left for the next lcd_stream_frame() to
+// handle, a frame flushed right away has been handled by lcd_flush() already.
+static void lcd_stream_complete(lcd_stream_t* stream, esp_err_t err, bool async) {
+    portENTER_CRITICAL_SAFE(&stream->lock);
+    stream->in_flight--;
+    if (err == ESP_OK) {
+        stream->frames_sent++;
+        stream->delivered = stream->delivered || async;
+    } else {
+        stream->frames_failed++;
+        if (async && stream->err == ESP_OK) {
+            stream->err = err;
+        }
+    }
+    portEXIT_CRITICAL_SAFE(&stream->lock);
+
+    if (stream->done != NULL) {
+        stream->done(stream->done_arg, err);
+    }
+}  // lcd_stream_complete()
+
+// Completion of an asynchronous frame, called by the transport and possibly from an interrupt
+static void lcd_stream_done(void* arg, esp_err_t err) {
+    lcd_stream_complete(arg, err, true);
+}  // lcd_stream_done()
+
+// A frame did not make it: it counts for the circuit breaker like a failed transaction, and the
+// modeled address counter and entry mode, which followed the frame while it was encoded, are
+// forgotten along with the DDRAM content, so the next frame rewrites everything. Returns err.
+static esp_err_t lcd_stream_failed(i2c_lcd_pcf8574_handle_t* lcd, esp_err_t err) {
+    lcd_transmit_failed(lcd, err);
+    return lcd_finish(lcd);
+}  // lcd_stream_failed()
+
+// Take the results of the asynchronous frames done since the last call: the first error, if a
+// frame failed, is handled and returned
+static esp_err_t lcd_stream_collect(lcd_stream_t* stream) {
+    portENTER_CRITICAL(&stream->lock);
+    const esp_err_t failed = stream->err;
+    stream->err = ESP_OK;
+    const bool delivered = stream->delivered;
+    stream->delivered = false;
+    portEXIT_CRITICAL(&stream->lock);
+
+    if (failed != ESP_OK) {
+        return lcd_stream_failed(stream->lcd, failed);
+    }
+    if (delivered) {
+        stream->lcd->failures = 0;
+    }
+    return ESP_OK;
+}  // lcd_stream_collect()
+
+// Set up frame streaming for a display
+esp_err_t lcd_stream_init(lcd_stream_t* stream, i2c_lcd_pcf8574_handle_t* lcd, lcd_transport_done_t done, void* arg) {
+    ESP_RETURN_ON_FALSE(stream != NULL && lcd != NULL, ESP_ERR_INVALID_ARG, TAG, "Invalid stream or LCD handle");
+    stream->lcd = lcd;
+    stream->len = 0;
+    stream->next = 0;
+    stream->in_flight = 0;
+    stream->err = ESP_OK;
+    stream->delivered = false;
+    stream->done = done;
+    stream->done_arg = arg;
+    portMUX_INITIALIZE(&stream->lock);
+    stream->frames_sent = 0;
+    stream->frames_failed = 0;
+    return ESP_OK;
+}  // lcd_stream_init()
+
+// Encode the framebuffer changes into the free frame and hand it to the transport
+esp_err_t lcd_stream_frame(lcd_stream_t* stream) {
+    LCD_NO_ALLOC_SCOPE(stream->lcd);
+    i2c_lcd_pcf8574_handle_t* lcd = stream->lcd;
+
+    // A frame that failed before is reported by this call, unless this one fails itself
+    const esp_err_t failed = lcd_stream_collect(stream);
+    if (stream->in_flight >= 2) {
+        return (failed != ESP_OK) ? failed : ESP_ERR_NOT_FINISHED;
+    }
+    const lcd_transport_t transport = lcd->transport;
+    if (transport.write_async == NULL || lcd->breaker_open || lcd->recover_pending) {
+        // Sent right here: no asynchronous transport, or a display that went offline
+        // has to be probed and restored on the bus
+        portENTER_CRITICAL(&stream->lock);
+        stream->in_flight++;
+        portEXIT_CRITICAL(&stream->lock);
+        esp_err_t ret = lcd_flush(lcd);
+        lcd_stream_complete(stream, ret, false);
+        return (ret != ESP_OK) ? ret : failed;
+    }
+
+    // Slow instructions sent before must be done before the frame starts
+    lcd_wait_ready(lcd);
+    if (lcd->bus_err != ESP_OK) {
+        // The busy flag read failed, no frame this time
+        return lcd_finish(lcd);
+    }
+
+    const bool busy_poll = lcd->busy_poll;
+    // Appending to the frame is no bus transaction, it must not count as one for the breaker
+    const uint8_t failures = lcd->failures;
+    const lcd_transport_t encoder = {
+        .write = lcd_stream_append,
+        .write_read = NULL,
+        .delay_us = lcd_stream_no_delay,
+        .write_async = NULL,
+        .ctx = stream,
+    };
+    stream->len = 0;
+    lcd->transport = encoder;
+    lcd->busy_poll = false;
+    esp_err_t ret = lcd_flush(lcd);
+    lcd->transport = transport;
+    lcd->busy_poll = busy_poll;
+    lcd->failures = failures;
+    ESP_RETURN_ON_ERROR(ret, TAG, "Failed to encode a frame");
+
+    const uint8_t* frame = stream->frames[stream->next];
+    if (stream->len == 0) {
+        // Nothing changed, the display is up to date already
+        if (stream->done != NULL) {
+            stream->done(stream->done_arg, ESP_OK);
+        }
+        return failed;
+    }
+
+    portENTER_CRITICAL(&stream->lock);
+    stream->in_flight++;
+    portEXIT_CRITICAL(&stream->lock);
+    stream->next ^= 1;
+    ret = transport.write_async(transport.ctx, frame, stream->len, lcd->timeout_ms, lcd_stream_done, stream);
+    if (ret != ESP_OK) {
+        portENTER_CRITICAL(&stream->lock);
+        stream->in_flight--;
+        portEXIT_CRITICAL(&stream->lock);
+        stream->next ^= 1;
+        return lcd_stream_failed(lcd, ret);
+    }
+    return failed;
+}  // lcd_stream_frame()
+
+// Wait until every frame is on the display, then report a frame that failed
+esp_err_t lcd_stream_wait(lcd_stream_t* stream, uint32_t timeout_ms) {
+    LCD_NO_ALLOC_SCOPE(stream->lcd);
+    const int64_t deadline_us = esp_timer_get_time() + timeout_ms * 1000LL;
+
+    while (stream->in_flight > 0) {
+        if (esp_timer_get_time() >= deadline_us) {
+            return ESP_ERR_TIMEOUT;
+        }
+        vTaskDelay(1);
+    }
+    return lcd_stream_collect(stream);
+}  // lcd_stream_wait()
@@ -0,0 +1,137 @@
+/// \file i2c_lcd_pcf8574_warm.c
+/// \brief Warm attach after a soft reset or deep sleep for the i2c_lcd_pcf8574 driver
+///
+/// The controller keeps its mode, DDRAM and CGRAM as long as it is powered. lcd_warm_save()
+/// copies the set-up and the DDRAM mirror of a handle into a state the application keeps in RTC
+/// memory. After the reset lcd_begin_warm() checks the state and that the controller answers in
+/// 4-bit mode, then takes everything over instead of running the reset sequence and the clear:
+/// the next flush only sends the cells that differ from what the display shows.
+///
+/// \author Femi Olugbon, https://iamflinks.github.io
+/// \copyright Copyright (c) 2024 by Femi Olugbon
+///
+/// ChangeLog see: i2c_lcd_pcf8574.h
+
+#include <stddef.h>
+#include <string.h>
+#include "i2c_lcd_pcf8574.h"
+#include "i2c_lcd_pcf8574_priv.h"
+#include "esp_log.h"
+#include "esp_check.h"
+
+
+#define TAG "I2C_LCD_PCF8574"
+
+
+// FNV-1a over the fields after the checksum, the padding at the end is left out
+static uint32_t lcd_warm_checksum(const lcd_warm_state_t* state) {
+    const uint8_t* bytes = (const uint8_t*)state + offsetof(lcd_warm_state_t, i2c_addr);
+    const size_t len = offsetof(lcd_warm_state_t, ddram) + sizeof(state->ddram) - offsetof(lcd_warm_state_t, i2c_addr);
+    uint32_t hash = 2166136261u;
+
+    for (size_t i = 0; i < len; i++) {
+        hash = (hash ^ bytes[i]) * 16777619u;
+    }
+    return hash;
+}  // lcd_warm_checksum()
+
+// Save what the display shows and its set-up
+void lcd_warm_save(const i2c_lcd_pcf8574_handle_t* lcd, lcd_warm_state_t* state) {
+    memset(state, 0, sizeof(*state));
+    state->i2c_addr = lcd->i2c_addr;
+    state->cols = lcd->cols;
+    state->lines = lcd->lines;
+    state->backlight = lcd->backlight;
+    state->displaycontrol = lcd->displaycontrol;
+    state->entrymode = lcd->entrymode;
+    state->page = lcd->page;
+    state->busy_poll = lcd->busy_poll;
+    // A batch that is still open has not reached the display
+    state->ddram_valid = lcd->ddram_valid && lcd->batch_depth == 0 && lcd->bus_err == ESP_OK;
+    state->page_stale = lcd->page_stale;
+    state->cgram_valid = lcd->cgram_valid;
+    memcpy(state->cgram, lcd->cgram, sizeof(state->cgram));
+    memcpy(state->ddram, lcd->ddram, sizeof(state->ddram));
+    // Without a known display shift the page shown can't be taken over
+    state->magic = (lcd->page_lost || lcd->breaker_open) ? 0 : LCD_WARM_MAGIC;
+    state->checksum = lcd_warm_checksum(state);
+}  // lcd_warm_save()
+
+// The state was saved for this display and survived the reset
+static bool lcd_warm_usable(const i2c_lcd_pcf8574_handle_t* lcd, uint8_t cols, uint8_t rows, const lcd_warm_state_t* state) {
+    if (state == NULL || state->magic != LCD_WARM_MAGIC || state->checksum != lcd_warm_checksum(state)) {
+        return false;
+    }
+    return state->i2c_addr == lcd->i2c_addr && state->cols == cols && state->lines == rows;
+}  // lcd_warm_usable()
+
+// Check that the controller answers. With RW wired (in the pin map, or polling was enabled when the
+// state was saved) this sets the address counter and reads it back, which only works in 4-bit mode
+// with the nibbles in step. Otherwise an acknowledged transaction is all there is to go by.
+static esp_err_t lcd_warm_probe(i2c_lcd_pcf8574_handle_t* lcd, bool busy_poll) {
+    if ((lcd->rw_mask == 0 && !busy_poll) || LCD_EXPANDER_8BIT(lcd) || lcd->transport.write_read == NULL) {
+        return lcd_set_backlight(lcd, lcd->backlight);
+    }
+    ESP_RETURN_ON_ERROR(lcd_set_busy_polling(lcd, true), TAG, "LCD 0x%02x is not in 4-bit mode", lcd->i2c_addr);
+    return busy_poll ? ESP_OK : lcd_set_busy_polling(lcd, false);
+}  // lcd_warm_probe()
+
+// Attach to a display that stayed powered, or initialize it
+esp_err_t lcd_begin_warm(i2c_lcd_pcf8574_handle_t* lcd, uint8_t cols, uint8_t rows, const lcd_warm_state_t* state, bool* warm) {
+    LCD_NO_ALLOC_SCOPE(lcd);
+    if (warm != NULL) {
+        *warm = false;
+    }
+    if (!lcd_warm_usable(lcd, cols, rows, state)) {
+        return lcd_begin(lcd, cols, rows);
+    }
+    ESP_RETURN_ON_FALSE(lcd->transport.write != NULL, ESP_ERR_INVALID_STATE, TAG, "No transport, see lcd_set_transport()");
+    ESP_RETURN_ON_ERROR(lcd_wait_setup(lcd), TAG, "Failed to create the wait timer");
+
+    lcd->cols = cols;
+    lcd->lines = rows;
+    lcd->page = state->page;
+    lcd->row_offsets[0] = 0x00 + state->page * cols;
+    lcd->row_offsets[1] = 0x40 + state->page * cols;
+    lcd->row_offsets[2] = 0x00 + cols;
+    lcd->row_offsets[3] = 0x40 + cols;
+    lcd->backlight = state->backlight;
+    lcd->ready_at_us = 0;
+    lcd_forget_state(lcd);
+
+    if (lcd_warm_probe(lcd, state->busy_poll) != ESP_OK) {
+        ESP_LOGW(TAG, "LCD 0x%02x did not answer as saved, initializing it", lcd->i2c_addr);
+        lcd->cgram_valid = 0;
+        return lcd_begin(lcd, cols, rows);
+    }
+
+    // Take over what the display shows: the framebuffer starts as a copy of it
+    memcpy(lcd->ddram, state->ddram, sizeof(lcd->ddram));
+    lcd->ddram_valid = state->ddram_valid;
+    lcd->flush_resync = 0;
+    lcd->page_stale = state->page_stale || !state->ddram_valid;
+    lcd->page_lost = false;
+    memset(lcd->fb, ' ', sizeof(lcd->fb));
+    for (uint8_t row = 0; row < rows; row++) {
+        for (uint8_t col = 0; col < cols; col++) {
+            lcd->fb[row * cols + col] = lcd->ddram[lcd_ddram_index(lcd, lcd->row_offsets[row] + col)];
+        }
+    }
+    memcpy(lcd->cgram, state->cgram, sizeof(lcd->cgram));
+    lcd->cgram_valid = state->cgram_valid;
+    memset(lcd->cgram_used, 0, sizeof(lcd->cgram_used));
+    lcd->cgram_clock = 0;
+
+    // Both are cheap and the modes after a reset of the MCU are known that way
+    lcd->displaycontrol = state->displaycontrol;
+    lcd->entrymode = state->entrymode;
+    lcd_batch_begin(lcd);
+    lcd_send_displaycontrol(lcd);
+    lcd_send_entrymode(lcd);
+    LCD_RETURN_ON_ERROR(lcd_batch_commit(lcd));
+    if (warm != NULL) {
+        *warm = true;
+    }
+    LCD_NO_ALLOC_ARM(lcd);
+    return ESP_OK;
+}  // lcd_begin_warm()
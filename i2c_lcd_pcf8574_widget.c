@@ -0,0 +1,198 @@
+/// \file i2c_lcd_pcf8574_widget.c
+/// \brief Bar graph and sparkline widgets with incremental updates for the i2c_lcd_pcf8574 driver
+///
+/// A cell is empty (space), full (the 0xFF block of the character ROM) or partly filled. The
+/// partial fills are a fixed set of glyphs in the glyph cache: 4 for horizontal bars (1 to 4 of
+/// the 5 pixel columns), 7 for vertical bars and sparklines (1 to 7 of the 8 pixel rows). Like
+/// numeric fields, a widget remembers what it shows and a new sample only sends the cells whose
+/// fill level changed, all in one transaction.
+///
+/// \author Femi Olugbon, https://iamflinks.github.io
+/// \copyright Copyright (c) 2024 by Femi Olugbon
+///
+/// ChangeLog see: i2c_lcd_pcf8574.h
+
+#include <string.h>
+#include "i2c_lcd_pcf8574.h"
+#include "i2c_lcd_pcf8574_priv.h"
+#include "esp_log.h"
+#include "esp_check.h"
+
+
+#define TAG "I2C_LCD_PCF8574"
+
+// Full block of the HD44780 character ROM
+#define LCD_WIDGET_FULL 0xFF
+
+// Pixel columns and rows of a character cell
+#define LCD_WIDGET_STEPS_H 5
+#define LCD_WIDGET_STEPS_V 8
+
+// Partial fills: index n - 1 lights n pixel columns from the left ...
+static const uint8_t s_fill_h[LCD_WIDGET_STEPS_H - 1][8] = {
+    { 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10 },
+    { 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18 },
+    { 0x1C, 0x1C, 0x1C, 0x1C, 0x1C, 0x1C, 0x1C, 0x1C },
+    { 0x1E, 0x1E, 0x1E, 0x1E, 0x1E, 0x1E, 0x1E, 0x1E },
+};
+
+// ... or n pixel rows from the bottom
+static const uint8_t s_fill_v[LCD_WIDGET_STEPS_V - 1][8] = {
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x1F },
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x1F, 0x1F },
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x1F, 0x1F, 0x1F },
+    { 0x00, 0x00, 0x00, 0x00, 0x1F, 0x1F, 0x1F, 0x1F },
+    { 0x00, 0x00, 0x00, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F },
+    { 0x00, 0x00, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F },
+    { 0x00, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F },
+};
+
+
+// Map a value to 0..steps, values outside of min..max are clamped
+static uint16_t lcd_widget_level(int32_t value, int32_t min, int32_t max, uint16_t steps) {
+    if (max <= min || value <= min) {
+        return 0;
+    }
+    if (value >= max) {
+        return steps;
+    }
+    const int64_t range = (int64_t)max - min;
+    return (uint16_t)((((int64_t)value - min) * steps + range / 2) / range);
+}  // lcd_widget_level()
+
+// Character code of a cell filled `fill` of `steps`. Without a free CGRAM slot the cell is
+// rounded to empty or full and *err is set.
+static uint8_t lcd_widget_code(i2c_lcd_pcf8574_handle_t* lcd, uint8_t fill, uint8_t steps, esp_err_t* err) {
+    if (fill == 0) {
+        return ' ';
+    }
+    if (fill >= steps) {
+        return LCD_WIDGET_FULL;
+    }
+
+    esp_err_t upload_err;
+    const uint8_t* bitmap = (steps == LCD_WIDGET_STEPS_H) ? s_fill_h[fill - 1] : s_fill_v[fill - 1];
+    int code = lcd_glyph_code(lcd, bitmap, &upload_err);
+    if (code < 0) {
+        *err = ESP_ERR_NO_MEM;
+        return (2 * fill >= steps) ? LCD_WIDGET_FULL : ' ';
+    }
+    if (upload_err != ESP_OK && *err == ESP_OK) {
+        *err = upload_err;
+    }
+    return code;
+}  // lcd_widget_code()
+
+// Put a cell into the framebuffer right away, so the glyph cache sees it in use, and send it
+// if the widget showed something else there
+static void lcd_widget_cell(i2c_lcd_pcf8574_handle_t* lcd, uint8_t col, uint8_t row, uint8_t code,
+                            uint8_t* shown, bool shown_valid) {
+    const uint8_t addr = lcd->row_offsets[row] + col;
+
+    if (lcd->cols * lcd->lines <= LCD_DDRAM_SIZE) {
+        lcd->fb[row * lcd->cols + col] = code;
+    }
+    if (shown_valid && *shown == code) {
+        return;
+    }
+    lcd_set_address(lcd, addr);
+    lcd_send(lcd, code, true);
+    lcd->ddram[lcd_ddram_index(lcd, addr)] = code;
+    *shown = code;
+}  // lcd_widget_cell()
+
+// Set up a bar
+void lcd_bar_init(lcd_bar_t* bar, uint8_t col, uint8_t row, uint8_t len, lcd_bar_dir_t dir, int32_t min, int32_t max) {
+    bar->col = col;
+    bar->row = row;
+    bar->len = (len > LCD_WIDGET_MAX_CELLS) ? LCD_WIDGET_MAX_CELLS : len;
+    bar->dir = dir;
+    bar->min = min;
+    bar->max = max;
+    bar->shown_valid = false;
+}  // lcd_bar_init()
+
+// Show a new value
+esp_err_t lcd_bar_update(i2c_lcd_pcf8574_handle_t* lcd, lcd_bar_t* bar, int32_t value) {
+    LCD_NO_ALLOC_SCOPE(lcd);
+    const bool horizontal = bar->dir == LCD_BAR_HORIZONTAL;
+    ESP_RETURN_ON_FALSE(horizontal ? (bar->row < lcd->lines && bar->col + bar->len <= lcd->cols)
+                                   : (bar->col < lcd->cols && bar->row < lcd->lines && bar->len <= bar->row + 1),
+                        ESP_ERR_INVALID_ARG, TAG, "Bar outside the display");
+
+    const uint8_t steps = horizontal ? LCD_WIDGET_STEPS_H : LCD_WIDGET_STEPS_V;
+    uint16_t level = lcd_widget_level(value, bar->min, bar->max, bar->len * steps);
+    esp_err_t ret = ESP_OK;
+
+    lcd_batch_begin(lcd);
+    // The address counter model needs to know the direction it moves in
+    lcd_send_entrymode(lcd);
+    for (uint8_t i = 0; i < bar->len; i++) {
+        const uint8_t fill = (level >= steps) ? steps : level;
+        const uint8_t code = lcd_widget_code(lcd, fill, steps, &ret);
+        level -= fill;
+        if (horizontal) {
+            lcd_widget_cell(lcd, bar->col + i, bar->row, code, &bar->shown[i], bar->shown_valid);
+        } else {
+            lcd_widget_cell(lcd, bar->col, bar->row - i, code, &bar->shown[i], bar->shown_valid);
+        }
+    }
+    bar->shown_valid = true;
+    esp_err_t bus_ret = lcd_batch_commit(lcd);
+    if (bus_ret != ESP_OK) {
+        // The display content is unknown now: the next update writes the whole bar
+        bar->shown_valid = false;
+        return bus_ret;
+    }
+    return ret;
+}  // lcd_bar_update()
+
+// Set up a sparkline
+void lcd_sparkline_init(lcd_sparkline_t* spark, uint8_t col, uint8_t row, uint8_t width, uint8_t height,
+                        int32_t min, int32_t max) {
+    spark->col = col;
+    spark->row = row;
+    spark->width = (width > LCD_WIDGET_MAX_CELLS) ? LCD_WIDGET_MAX_CELLS : width;
+    spark->height = (height > LCD_MAX_ROWS) ? LCD_MAX_ROWS : height;
+    spark->min = min;
+    spark->max = max;
+    spark->count = 0;
+    spark->shown_valid = false;
+}  // lcd_sparkline_init()
+
+// Add a sample and redraw the cells that change
+esp_err_t lcd_sparkline_push(i2c_lcd_pcf8574_handle_t* lcd, lcd_sparkline_t* spark, int32_t value) {
+    LCD_NO_ALLOC_SCOPE(lcd);
+    ESP_RETURN_ON_FALSE(spark->height > 0 && spark->row + spark->height <= lcd->lines &&
+                        spark->col + spark->width <= lcd->cols,
+                        ESP_ERR_INVALID_ARG, TAG, "Sparkline outside the display");
+
+    if (spark->count == spark->width) {
+        memmove(spark->levels, spark->levels + 1, spark->width - 1);
+        spark->count--;
+    }
+    spark->levels[spark->count++] = lcd_widget_level(value, spark->min, spark->max, spark->height * LCD_WIDGET_STEPS_V);
+
+    // The samples are right aligned, the newest in the last column
+    const uint8_t empty = spark->width - spark->count;
+    esp_err_t ret = ESP_OK;
+    lcd_batch_begin(lcd);
+    lcd_send_entrymode(lcd);
+    for (uint8_t r = 0; r < spark->height; r++) {
+        // Steps below this row
+        const int16_t base = (spark->height - 1 - r) * LCD_WIDGET_STEPS_V;
+        for (uint8_t c = 0; c < spark->width; c++) {
+            const int16_t above = (c < empty) ? 0 : spark->levels[c - empty] - base;
+            const uint8_t fill = (above <= 0) ? 0 : (above >= LCD_WIDGET_STEPS_V) ? LCD_WIDGET_STEPS_V : above;
+            const uint8_t code = lcd_widget_code(lcd, fill, LCD_WIDGET_STEPS_V, &ret);
+            lcd_widget_cell(lcd, spark->col + c, spark->row + r, code, &spark->shown[r][c], spark->shown_valid);
+        }
+    }
+    spark->shown_valid = true;
+    esp_err_t bus_ret = lcd_batch_commit(lcd);
+    if (bus_ret != ESP_OK) {
+        spark->shown_valid = false;
+        return bus_ret;
+    }
+    return ret;
+}  // lcd_sparkline_push()
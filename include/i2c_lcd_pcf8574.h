@@ -14,6 +14,51 @@
 /// ===========
 /// * 07/22/2024 --> Created
 /// * 07/23/2024 --> Added number printing functionality
+/// * 10/17/2026 --> Added transaction batching (lcd_batch_begin/lcd_batch_commit/lcd_write_buffer)
+/// * 10/17/2026 --> Added shadow framebuffer with dirty-cell flush (lcd_fb_*/lcd_flush)
+/// * 10/17/2026 --> Added optional render task with latest-value-wins update queue (lcd_render_*)
+/// * 10/17/2026 --> Replaced fixed busy-wait delays with a per-handle "controller ready" deadline
+/// * 10/17/2026 --> Send through a static per-handle command link: no heap allocation per transfer
+/// * 10/17/2026 --> Added nibble encoding tables, bulk encoder and lcd_set_pin_map()
+/// * 10/17/2026 --> Added optional busy flag polling through the PCF8574 read path
+/// * 10/17/2026 --> Added bus scheduler for several displays on one I2C port (lcd_bus_*)
+/// * 10/17/2026 --> Added lock-free multi-producer write ring (lcd_ring_*)
+/// * 10/17/2026 --> Added CGRAM glyph cache for more than 8 custom characters (lcd_fb_put_glyph)
+/// * 10/17/2026 --> Added numeric fields with incremental digit updates (lcd_field_*),
+///                  lcd_print_number() returns an error for buf_len == 0 or an encoding error
+/// * 10/17/2026 --> Added host build with an emulated HD44780 + PCF8574 on a fake I2C bus (host/)
+/// * 10/17/2026 --> Added per-handle performance counters and latency histogram (lcd_perf_*)
+/// * 10/17/2026 --> All functions that talk to the display return esp_err_t and fail fast,
+///                  added per-handle timeout and circuit breaker with automatic recovery
+/// * 10/17/2026 --> Added page flipping through the off-screen DDRAM (lcd_page_flip)
+/// * 10/17/2026 --> Added timer driven marquee with per-row text and speed (lcd_marquee_*)
+/// * 10/17/2026 --> Model the address counter, display control and entry mode of the controller
+///                  and leave out commands that would not change them
+/// * 10/17/2026 --> Added header-only C++ front end with compile-time geometry and pin map
+///                  (i2c_lcd_pcf8574.hpp) and lcd_write_encoded(), lcd_begin() rejects geometries
+///                  the controller can't address instead of clamping them
+/// * 10/17/2026 --> Added 8-bit mode through MCP23017 and PCA9555 16-bit expanders (lcd_set_expander)
+/// * 10/17/2026 --> Send through a pluggable transport (lcd_set_transport): legacy I2C driver,
+///                  I2C master driver and in-memory capture
+/// * 10/17/2026 --> Added frame streaming (lcd_stream_frame) with double-buffered wire frames and
+///                  completion callbacks, asynchronous I2C master transport
+/// * 10/17/2026 --> Added warm attach (lcd_begin_warm) from a state kept in RTC memory, skips the
+///                  reset sequence and the clear after a soft reset or deep sleep
+/// * 10/17/2026 --> Added bar graph and sparkline widgets with sub-cell resolution and
+///                  incremental updates (lcd_bar_*, lcd_sparkline_*)
+/// * 10/17/2026 --> Added benchmark example and host benchmark with JSON-lines results
+/// * 10/17/2026 --> Added scrolling console (lcd_console_*) with line wrap, collapsed repeats,
+///                  rate-limited flushes and an esp_log sink
+/// * 10/17/2026 --> LCD_PCF8574_ASSERT_NO_ALLOC checks every driver call after lcd_begin() through
+///                  lcd_check_alloc(), called from the application's heap allocation hook
+/// * 10/17/2026 --> The asynchronous I2C master transport keeps a write whose wait timed out
+///                  queued in its own buffers until the driver is done with it
+/// * 10/17/2026 --> Waits shorter than a tick sleep on a one-shot esp_timer created by lcd_begin()
+///                  and only spin for the last LCD_WAIT_SPIN_US
+/// * 10/17/2026 --> lcd_init() leaves rw_mask 0 (RW not wired) as before busy flag polling,
+///                  lcd_set_busy_polling() puts RW on P1 of the default pin map
+/// * 10/17/2026 --> A failed busy flag read fails the operation and counts for the circuit breaker,
+///                  polling is only turned off when the flag stays set past the worst case time
 ///
 
 #pragma once
@@ -22,9 +67,21 @@
 #define I2C_LCD_PCF8574_H
 
 #include <stdint.h>
+#include <stddef.h>
 #include <stdbool.h>
+#include <stdarg.h>
+#include "sdkconfig.h"
 #include "esp_err.h"
+#include "esp_timer.h"
+#if CONFIG_LCD_PCF8574_I2C_MASTER
+#include "driver/i2c_master.h"
+#else
 #include "driver/i2c.h"
+#endif
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
 
 
 #ifdef __cplusplus
@@ -33,6 +90,274 @@ extern "C" {
 
 #define LCD_MAX_ROWS 4
 
+// Size of the per-handle batch buffer in expander bytes (4 bytes per LCD byte).
+// The default holds a full 20x4 screen plus one set-cursor command per row.
+#ifndef LCD_BATCH_BUF_SIZE
+#define LCD_BATCH_BUF_SIZE 336
+#endif
+
+// Marks a saved lcd_warm_state_t
+#define LCD_WARM_MAGIC 0x4C434457
+
+// Size of a streamed frame: entry mode, an address per row and every character, 4 bytes each
+#define LCD_STREAM_FRAME_SIZE (4 * (1 + LCD_MAX_ROWS + LCD_DDRAM_SIZE))
+
+// Transactions the asynchronous I2C master transport keeps track of: two frames and a write of
+// the rest of the API. The bus needs a trans_queue_depth of at least this.
+#define LCD_MASTER_ASYNC_DEPTH 3
+
+// Longest read-back through the asynchronous I2C master transport (the busy flag takes one byte)
+#define LCD_MASTER_ASYNC_RX 1
+
+// Longest text a single lcd_render_post() call carries (one full 40 character line)
+#define LCD_RENDER_TEXT_MAX 40
+
+#if CONFIG_LCD_PCF8574_I2C_LEGACY
+// Size of the I2C command link buffer of the legacy transport (used with i2c_cmd_link_create_static())
+#define LCD_CMD_LINK_SIZE I2C_LINK_RECOMMENDED_SIZE(2)
+#endif
+
+// Most displays one bus scheduler serves (PCF8574 addresses 0x20 - 0x27)
+#define LCD_BUS_MAX_DISPLAYS 8
+
+// Slots of a write ring (power of two) and the longest text one positioned write carries
+#define LCD_RING_SIZE 16
+#define LCD_RING_TEXT_MAX 20
+
+// Widest numeric field, see lcd_field_init()
+#define LCD_FIELD_MAX_WIDTH 16
+
+// Longest bar and widest sparkline, see lcd_bar_init() and lcd_sparkline_init()
+#define LCD_WIDGET_MAX_CELLS 20
+
+// Widest console row (a DDRAM line in 2-line mode) and the longest text one formatted console
+// write or log message carries, see lcd_console_init()
+#define LCD_CONSOLE_MAX_COLS 40
+#define LCD_CONSOLE_TEXT_MAX 128
+
+// Tasks that can be inside driver calls of one display at the same time and are checked by
+// lcd_check_alloc() (CONFIG_LCD_PCF8574_ASSERT_NO_ALLOC)
+#ifndef LCD_NO_ALLOC_TASKS
+#define LCD_NO_ALLOC_TASKS 4
+#endif
+
+// Default timeout of one I2C transaction, see lcd_set_timeout()
+#ifndef LCD_DEFAULT_TIMEOUT_MS
+#define LCD_DEFAULT_TIMEOUT_MS 1000
+#endif
+
+// Spaces between the end of a scrolling marquee text and its next start
+#define LCD_MARQUEE_GAP 4
+
+// Circuit breaker defaults: failures in a row that take a display offline and the probe backoff
+#define LCD_BREAKER_THRESHOLD 3
+#define LCD_BREAKER_BACKOFF_MIN_MS 100
+#define LCD_BREAKER_BACKOFF_MAX_MS 10000
+
+// Size of the HD44780 display data RAM: 80 characters (2 lines of 40 in 2-line mode)
+#define LCD_DDRAM_SIZE 80
+
+// Geometries lcd_begin() accepts: 1 row of up to 80 columns, 2 rows of up to 40, 3 or 4 rows of up to 20
+#define LCD_GEOMETRY_VALID(cols, rows) ((rows) >= 1 && (rows) <= LCD_MAX_ROWS && (cols) >= 1 && \
+                                        (cols) <= ((rows) == 1 ? 80 : (rows) == 2 ? 40 : 20))
+
+// Expander between the I2C bus and the display, see lcd_set_expander()
+typedef enum {
+    LCD_EXPANDER_PCF8574,   // 8 pins: 4-bit mode, two E pulses per byte (default)
+    LCD_EXPANDER_MCP23017,  // 16 pins: 8-bit mode, RS/RW/E/BL on port A, D0..D7 on port B
+    LCD_EXPANDER_PCA9555,   // 16 pins: 8-bit mode, RS/RW/E/BL on port 0, D0..D7 on port 1
+} lcd_expander_t;
+
+// Alignment of a numeric field
+typedef enum {
+    LCD_ALIGN_RIGHT,
+    LCD_ALIGN_LEFT,
+} lcd_align_t;
+
+// Numeric field at a fixed position, see lcd_field_init()
+typedef struct
+{
+    uint8_t col;
+    uint8_t row;
+    uint8_t width;
+    uint8_t decimals;                   // Fixed point scale: the value is divided by 10^decimals
+    lcd_align_t align;
+    bool shown_valid;                   // shown[] is what the display shows
+    char shown[LCD_FIELD_MAX_WIDTH];
+} lcd_field_t;
+
+// Direction a bar grows in
+typedef enum {
+    LCD_BAR_HORIZONTAL,     // Left to right, 5 steps per cell
+    LCD_BAR_VERTICAL,       // Bottom to top, 8 steps per cell
+} lcd_bar_dir_t;
+
+// Bar graph at a fixed position, see lcd_bar_init()
+typedef struct
+{
+    uint8_t col;
+    uint8_t row;                        // Vertical bars: the bottom row
+    uint8_t len;                        // Cells
+    lcd_bar_dir_t dir;
+    int32_t min;
+    int32_t max;
+    bool shown_valid;                   // shown[] is what the display shows
+    uint8_t shown[LCD_WIDGET_MAX_CELLS];
+} lcd_bar_t;
+
+// Scrolling sparkline: one column per sample, the newest on the right, see lcd_sparkline_init()
+typedef struct
+{
+    uint8_t col;
+    uint8_t row;                        // Top row
+    uint8_t width;
+    uint8_t height;                     // Rows, 8 steps each
+    int32_t min;
+    int32_t max;
+    uint8_t count;                      // Samples so far, up to width
+    uint8_t levels[LCD_WIDGET_MAX_CELLS];   // Oldest first
+    bool shown_valid;
+    uint8_t shown[LCD_MAX_ROWS][LCD_WIDGET_MAX_CELLS];
+} lcd_sparkline_t;
+
+// Render task configuration, see lcd_render_start()
+typedef struct
+{
+    UBaseType_t priority;   // Priority of the render task
+    BaseType_t core_id;     // Core the task is pinned to, tskNO_AFFINITY for any core
+    uint32_t stack_size;    // Stack size of the render task in bytes
+    uint8_t queue_len;      // Number of updates for different regions that can wait for the task
+} lcd_render_config_t;
+
+#define LCD_RENDER_CONFIG_DEFAULT() {   \
+    .priority = 5,                      \
+    .core_id = tskNO_AFFINITY,          \
+    .stack_size = 3072,                 \
+    .queue_len = 16,                    \
+}
+
+// Render task statistics, see lcd_render_get_stats()
+typedef struct
+{
+    uint32_t queue_depth;   // Updates currently waiting in the queue
+    uint32_t posted;        // Updates accepted by lcd_render_post()/lcd_render_post_clear()
+    uint32_t dropped;       // Updates refused because the queue was full of updates for other regions
+    uint32_t coalesced;     // Queued updates replaced or merged by a newer one for the same region
+    uint32_t flushes;       // Framebuffer flushes done by the task
+    uint32_t flush_errors;  // Flushes that failed, the next flush sends the changes again
+    esp_err_t last_error;   // Error of the last failed flush
+} lcd_render_stats_t;
+
+// One positioned write in a write ring
+typedef struct
+{
+    uint32_t seq;           // Slot sequence number, only accessed atomically
+    uint8_t col;
+    uint8_t row;
+    uint8_t len;
+    uint8_t text[LCD_RING_TEXT_MAX];
+} lcd_ring_slot_t;
+
+// Lock-free multi-producer, single-consumer ring of positioned writes, see lcd_ring_attach()
+typedef struct
+{
+    uint32_t head;          // Next slot producers claim, only accessed atomically
+    uint32_t tail;          // Next slot the consumer reads
+    uint32_t dropped;       // Writes refused because the ring was full, only accessed atomically
+    lcd_ring_slot_t slots[LCD_RING_SIZE];
+} lcd_write_ring_t;
+
+// Performance counters: log2 latency buckets of i2c_master_cmd_begin() and error codes kept apart
+#define LCD_PERF_LATENCY_BUCKETS 12
+#define LCD_PERF_ERROR_CODES 4
+
+// Count of failed transactions with one error code
+typedef struct
+{
+    esp_err_t code;
+    uint32_t count;
+} lcd_perf_error_t;
+
+// Per-handle performance counters, see lcd_perf_get()
+typedef struct
+{
+    uint32_t transactions;      // I2C transactions issued
+    uint32_t bytes;             // Bytes on the wire: address bytes, expander bytes written and read
+    uint32_t chars;             // Characters (data bytes) encoded for the controller, dropped ones included
+    uint32_t commands;          // Instructions encoded for the controller, reset nibbles and dropped ones included
+    uint32_t elided;            // Instructions left out because the controller state already matched
+    uint64_t bus_us;            // Time spent in the transport's write and write_read
+    uint64_t delay_us;          // Time spent spinning in the transport's delay_us for the controller
+    uint64_t sleep_us;          // Time spent in vTaskDelay() for the controller
+    uint32_t latency_max_us;    // Longest transaction
+    uint32_t latency[LCD_PERF_LATENCY_BUCKETS]; // Bucket 0: < 64us, bucket i: < (64us << i), the last takes the rest
+    uint32_t errors;            // Failed transactions
+    uint32_t errors_other;      // Failed transactions whose code found no free slot in error_codes
+    lcd_perf_error_t error_codes[LCD_PERF_ERROR_CODES]; // Failures by error code, in order of first appearance
+} lcd_perf_t;
+
+// Completion of an asynchronous transaction, may be called from an interrupt
+typedef void (*lcd_transport_done_t)(void* arg, esp_err_t err);
+
+// Bus access of a display, see lcd_set_transport(). The driver hands over whole transactions as
+// contiguous buffers of expander bytes, behind a 16-bit expander with the register byte in front.
+typedef struct
+{
+    // Write the bytes to the device in one transaction
+    esp_err_t (*write)(void* ctx, const uint8_t* bytes, size_t len, uint32_t timeout_ms);
+    // Write the bytes, then read rx_len bytes after a repeated start (busy flag polling, may be NULL)
+    esp_err_t (*write_read)(void* ctx, const uint8_t* bytes, size_t len, uint8_t* rx, size_t rx_len, uint32_t timeout_ms);
+    // Wait for the controller, less than a tick: longer waits sleep in vTaskDelay() first
+    void (*delay_us)(void* ctx, uint32_t us);
+    // Queue the bytes and return right away, done is called once they are sent (lcd_stream_frame(),
+    // may be NULL). The bytes stay untouched until then.
+    esp_err_t (*write_async)(void* ctx, const uint8_t* bytes, size_t len, uint32_t timeout_ms,
+                             lcd_transport_done_t done, void* arg);
+    void* ctx;
+} lcd_transport_t;
+
+#if CONFIG_LCD_PCF8574_I2C_LEGACY
+// Device on a port of the legacy I2C driver, with a command link that lives here instead of the heap
+typedef struct
+{
+    i2c_port_t port;
+    uint8_t addr;
+    uint8_t cmd_link_buf[LCD_CMD_LINK_SIZE];
+} lcd_legacy_bus_t;
+#endif
+
+#if CONFIG_LCD_PCF8574_I2C_MASTER
+// Device of the I2C master driver on a bus in asynchronous mode, see lcd_transport_i2c_master_async()
+typedef struct
+{
+    i2c_master_dev_handle_t dev;
+    struct {
+        lcd_transport_done_t done;      // NULL for a write the caller waits for
+        void* arg;
+    } pending[LCD_MASTER_ASYNC_DEPTH];  // Queued transactions, they finish in order
+    uint8_t head;
+    uint8_t count;
+    esp_err_t sync_err;
+    SemaphoreHandle_t sync;             // Given when a write the caller waits for is done
+    StaticSemaphore_t sync_buf;
+    bool sync_abandoned;                // The caller of the last write timed out, it is still queued
+    uint8_t sync_tx[1 + LCD_BATCH_BUF_SIZE]; // Bytes and read-back of the write the caller waits for,
+    uint8_t sync_rx[LCD_MASTER_ASYNC_RX];    // the driver keeps them until it is done
+    portMUX_TYPE lock;
+} lcd_master_async_t;
+#endif
+
+// In-memory transport: collects what the driver sends instead of talking to a bus
+typedef struct
+{
+    uint8_t* buf;
+    size_t size;
+    size_t len;                 // Bytes collected, all transactions back to back
+    uint32_t transactions;
+    bool overflow;              // Bytes were dropped because buf was full
+    uint64_t delay_us;          // Sum of the waits the driver asked for, none of them is done
+} lcd_capture_t;
+
 typedef struct
 {
     uint8_t i2c_addr;
@@ -41,68 +366,478 @@ typedef struct
     uint8_t lines;
     uint8_t entrymode;
     uint8_t displaycontrol;
+    uint8_t sent_entrymode;         // Entry mode the controller has, 0xFF when unknown
+    uint8_t sent_displaycontrol;    // Display control the controller has, 0xFF when unknown
+    int16_t ac;                     // DDRAM address counter of the controller, -1 when unknown or in CGRAM
     uint8_t row_offsets[LCD_MAX_ROWS];
     uint8_t rs_mask;
     uint8_t rw_mask;
     uint8_t enable_mask;
     uint8_t backlight_mask;
     uint8_t data_mask[4];
+    lcd_expander_t expander;
+    uint8_t expander_reg;           // 16-bit expanders: register a transaction starts writing at
+#if !CONFIG_LCD_PCF8574_FIXED_PINMAP
+    uint8_t nibble_lut[2][16][2];   // Expander bytes per [command/data][nibble][E high/E low], without backlight
+    uint8_t data_lut[2][16];        // 16-bit expanders: data port bits per [low/high][nibble]
+#endif
     i2c_port_t i2c_port;
+    int64_t ready_at_us;            // esp_timer time at which the controller takes the next instruction
+    bool busy_poll;                 // Read the busy flag instead of waiting until ready_at_us
+    esp_timer_handle_t wait_timer;  // One-shot timer a wait shorter than a tick sleeps on, see lcd_begin()
+    SemaphoreHandle_t wait_sem;     // Given by wait_timer
+    StaticSemaphore_t wait_sem_buf;
+    bool wait_spin;                 // The caller runs in the esp_timer task: spin instead of waiting for wait_timer
+    uint8_t batch_depth;
+    uint16_t batch_len;
+    uint8_t batch_buf[1 + LCD_BATCH_BUF_SIZE]; // Batched expander bytes from index 1, 0 is kept for a register byte
+    lcd_transport_t transport;
+#if CONFIG_LCD_PCF8574_I2C_LEGACY
+    lcd_legacy_bus_t legacy;        // Bus of the default transport lcd_init() sets up
+#endif
+    bool ddram_valid;               // ddram[] matches the controller
+    uint8_t flush_resync;           // While !ddram_valid: cells before this one are known
+    uint8_t fb[LCD_DDRAM_SIZE];     // Framebuffer: wanted content, indexed row * cols + col
+    uint8_t ddram[LCD_DDRAM_SIZE];  // Mirror of the controller DDRAM, see lcd_ddram_index()
+    uint8_t page;                   // Page shown, see lcd_page_flip(): its columns start at page * cols
+    bool page_stale;                // The content of the page not shown is unknown
+    bool page_lost;                 // A flip failed half way, the display shift is unknown
+    uint8_t cgram[8][8];            // Content of the 8 CGRAM slots, see cgram_valid
+    uint8_t cgram_valid;            // Bit per CGRAM slot with known content
+    uint32_t cgram_used[8];         // Glyph cache: last use of each slot, for LRU eviction
+    uint32_t cgram_clock;
+    lcd_write_ring_t* ring;
+    TaskHandle_t render_task;
+    struct lcd_render_update* render_queue; // Updates waiting for the task, oldest first, under render_lock
+    uint8_t render_queue_len;
+    uint8_t render_queued;
+    bool render_stopping;           // lcd_render_stop() was called, posts are refused
+    uint8_t render_posting;         // Posts between their check of render_stopping and waking the task
+    volatile bool render_running;
+    portMUX_TYPE render_lock;
+    lcd_render_stats_t render_stats;
+    uint32_t timeout_ms;            // Timeout of one I2C transaction
+    esp_err_t bus_err;              // First failure of the running operation, see lcd_finish()
+    uint8_t failures;               // Failed transactions in a row
+    uint8_t breaker_threshold;      // Failures in a row that take the display offline, 0 never
+    bool breaker_open;              // Display is offline: writes fail without touching the bus
+    bool recover_pending;           // Display answers again and needs its state restored
+    uint32_t backoff_min_ms;
+    uint32_t backoff_max_ms;
+    uint32_t backoff_ms;            // Time between probes of an offline display, doubles per failed probe
+    int64_t probe_at_us;            // esp_timer time of the next probe
+#if CONFIG_LCD_PCF8574_PERF_COUNTERS
+    portMUX_TYPE perf_lock;
+    lcd_perf_t perf;
+#endif
+#if CONFIG_LCD_PCF8574_ASSERT_NO_ALLOC
+    bool no_alloc;                  // lcd_begin() is done: driver calls must not allocate
+    portMUX_TYPE no_alloc_lock;
+    TaskHandle_t volatile no_alloc_task[LCD_NO_ALLOC_TASKS]; // Tasks inside a driver call
+    uint8_t no_alloc_depth[LCD_NO_ALLOC_TASKS];              // Nested calls of each of them
+#endif
 } i2c_lcd_pcf8574_handle_t;
 
+// One row of a marquee, see lcd_marquee_set_text()
+typedef struct
+{
+    const char* next_text;      // Set by lcd_marquee_set_text() under the lock, taken by the timer
+    uint32_t next_interval_ms;
+    bool changed;
+    const char* text;           // Text shown, only the timer callback touches the fields from here on
+    size_t len;
+    size_t pos;                 // Text column shown in display column 0
+    uint32_t interval_ms;       // Time per one column step
+    int64_t next_us;            // esp_timer time of the next step
+} lcd_marquee_row_t;
+
+// Marquee: scrolls text longer than the display from an esp_timer, see lcd_marquee_start()
+typedef struct
+{
+    i2c_lcd_pcf8574_handle_t* lcd;
+    esp_timer_handle_t timer;
+    portMUX_TYPE lock;
+    bool stopping;
+    volatile bool ticking;      // The timer callback runs, set and cleared under the lock
+    bool shifting;              // The rows move with display shift instructions
+    bool resync;                // A step failed: return home and draw everything again
+    uint8_t shift;              // DDRAM column shown in display column 0
+    uint32_t shift_steps;       // Steps done with one display shift instruction
+    uint32_t redraw_steps;      // Steps done by redrawing rows in the framebuffer
+    lcd_marquee_row_t rows[LCD_MAX_ROWS];
+} lcd_marquee_t;
+
+// Per-display bus scheduler statistics, see lcd_bus_get_stats()
+typedef struct
+{
+    uint32_t cells;             // Characters sent
+    uint32_t transactions;      // I2C transactions issued for this display
+    uint32_t busy_skips;        // Turns skipped because the controller was still busy
+    uint32_t errors;            // Turns that failed
+    uint32_t cells_per_sec;     // Throughput since the statistics were reset
+} lcd_bus_stats_t;
+
+// Bus scheduler: serves the framebuffers of several displays sharing one I2C port
+typedef struct
+{
+    i2c_port_t i2c_port;
+    uint8_t count;
+    uint8_t next;                       // Display that gets the first turn of the next round
+    uint8_t pending;                    // Bit per display with framebuffer changes left after the last round
+    uint16_t quantum;                   // Most cells a display sends per turn
+    esp_err_t err;                      // First failed turn since lcd_bus_flush_all() started
+    int64_t stats_since_us;
+    i2c_lcd_pcf8574_handle_t* displays[LCD_BUS_MAX_DISPLAYS];
+    lcd_bus_stats_t stats[LCD_BUS_MAX_DISPLAYS];
+} lcd_bus_scheduler_t;
+
+// What a display shows and how it is set up, kept over a soft reset or deep sleep in RTC memory
+// (RTC_NOINIT_ATTR), see lcd_warm_save() and lcd_begin_warm()
+typedef struct
+{
+    uint32_t magic;             // LCD_WARM_MAGIC once saved
+    uint32_t checksum;          // Over the fields below, checks that the RTC memory survived
+    uint8_t i2c_addr;
+    uint8_t cols;
+    uint8_t lines;
+    uint8_t backlight;
+    uint8_t displaycontrol;
+    uint8_t entrymode;
+    uint8_t page;
+    bool busy_poll;
+    bool ddram_valid;
+    bool page_stale;
+    uint8_t cgram_valid;
+    uint8_t cgram[8][8];
+    uint8_t ddram[LCD_DDRAM_SIZE];
+} lcd_warm_state_t;
+
+// Frame streaming: framebuffer changes encoded into one of two wire frames and handed to the
+// transport, see lcd_stream_frame()
+typedef struct
+{
+    i2c_lcd_pcf8574_handle_t* lcd;
+    uint8_t frames[2][1 + LCD_STREAM_FRAME_SIZE];   // Wire bytes, behind a 16-bit expander the register byte first
+    size_t len;                 // Bytes of the frame being encoded
+    uint8_t next;               // Frame encoded next, the other one may still be on the way
+    volatile uint8_t in_flight; // Frames handed to the transport that are not done yet
+    volatile esp_err_t err;     // First failure a completion reported since the last frame
+    volatile bool delivered;    // A frame arrived since the last frame
+    lcd_transport_done_t done;  // Called when a frame is on the display, may be from an interrupt
+    void* done_arg;
+    portMUX_TYPE lock;
+    uint32_t frames_sent;
+    uint32_t frames_failed;
+} lcd_stream_t;
+
+// One line of a console
+typedef struct
+{
+    char text[LCD_CONSOLE_MAX_COLS];
+    uint8_t len;
+    bool wrapped;               // Continues on the next line, it didn't end with a newline
+    uint16_t repeats;           // Times the line came in a row, shown as a counter at the end of the row
+} lcd_console_line_t;
+
+// Console: text scrolls up from the bottom row, the lines are kept in RAM and drawn through the
+// framebuffer, see lcd_console_init()
+typedef struct
+{
+    i2c_lcd_pcf8574_handle_t* lcd;
+    portMUX_TYPE lock;
+    bool wrap;                  // Text past the end of a row goes on on the next row, else it is cut off
+    uint8_t esc;                // State of an ANSI escape sequence being skipped
+    uint8_t newest;             // Ring index of the newest finished line
+    uint8_t count;              // Finished lines in the ring
+    lcd_console_line_t lines[LCD_MAX_ROWS];
+    lcd_console_line_t cur;     // Line being written, shown on the bottom row once it has text
+    bool dirty;                 // The lines changed since the last flush
+    bool flushing;              // A write is flushing, the others leave their changes to it
+    int64_t min_interval_us;    // Shortest time between two flushes
+    int64_t next_flush_us;      // esp_timer time the next flush is allowed at
+    uint32_t lines_added;       // Lines scrolled in
+    uint32_t lines_collapsed;   // Repeated lines counted on the row above instead of scrolled in
+    uint32_t flushes;
+    uint32_t flushes_held;      // Writes the rate limit kept from flushing
+} lcd_console_t;
+
 
 // Initialize the LCD
-void lcd_init(i2c_lcd_pcf8574_handle_t* lcd, uint8_t i2c_addr, i2c_port_t i2c_port);
+esp_err_t lcd_init(i2c_lcd_pcf8574_handle_t* lcd, uint8_t i2c_addr, i2c_port_t i2c_port);
 
-// Begin using the LCD
-void lcd_begin(i2c_lcd_pcf8574_handle_t* lcd, uint8_t cols, uint8_t rows);
+// Begin using the LCD, fails with ESP_ERR_INVALID_ARG unless LCD_GEOMETRY_VALID(cols, rows)
+esp_err_t lcd_begin(i2c_lcd_pcf8574_handle_t* lcd, uint8_t cols, uint8_t rows);
 
 // Clear the LCD
-void lcd_clear(i2c_lcd_pcf8574_handle_t* lcd);
+esp_err_t lcd_clear(i2c_lcd_pcf8574_handle_t* lcd);
 
 // Move cursor to home position
-void lcd_home(i2c_lcd_pcf8574_handle_t* lcd);
+esp_err_t lcd_home(i2c_lcd_pcf8574_handle_t* lcd);
 
 // Set cursor position
-void lcd_set_cursor(i2c_lcd_pcf8574_handle_t* lcd, uint8_t col, uint8_t row);
+esp_err_t lcd_set_cursor(i2c_lcd_pcf8574_handle_t* lcd, uint8_t col, uint8_t row);
 
 // Turn the display on/off
-void lcd_no_display(i2c_lcd_pcf8574_handle_t* lcd);
-void lcd_display(i2c_lcd_pcf8574_handle_t* lcd);
+esp_err_t lcd_no_display(i2c_lcd_pcf8574_handle_t* lcd);
+esp_err_t lcd_display(i2c_lcd_pcf8574_handle_t* lcd);
 
 // Turn the cursor on/off
-void lcd_cursor(i2c_lcd_pcf8574_handle_t* lcd);
-void lcd_no_cursor(i2c_lcd_pcf8574_handle_t* lcd);
+esp_err_t lcd_cursor(i2c_lcd_pcf8574_handle_t* lcd);
+esp_err_t lcd_no_cursor(i2c_lcd_pcf8574_handle_t* lcd);
 
 // Turn blinking cursor on/off
-void lcd_blink(i2c_lcd_pcf8574_handle_t* lcd);
-void lcd_no_blink(i2c_lcd_pcf8574_handle_t* lcd);
+esp_err_t lcd_blink(i2c_lcd_pcf8574_handle_t* lcd);
+esp_err_t lcd_no_blink(i2c_lcd_pcf8574_handle_t* lcd);
 
 // Scroll the display
-void lcd_scroll_display_left(i2c_lcd_pcf8574_handle_t* lcd);
-void lcd_scroll_display_right(i2c_lcd_pcf8574_handle_t* lcd);
+esp_err_t lcd_scroll_display_left(i2c_lcd_pcf8574_handle_t* lcd);
+esp_err_t lcd_scroll_display_right(i2c_lcd_pcf8574_handle_t* lcd);
 
 // Set the direction for text that flows automatically
-void lcd_left_to_right(i2c_lcd_pcf8574_handle_t* lcd);
-void lcd_right_to_left(i2c_lcd_pcf8574_handle_t* lcd);
+esp_err_t lcd_left_to_right(i2c_lcd_pcf8574_handle_t* lcd);
+esp_err_t lcd_right_to_left(i2c_lcd_pcf8574_handle_t* lcd);
 
 // Turn on/off autoscroll
-void lcd_autoscroll(i2c_lcd_pcf8574_handle_t* lcd);
-void lcd_no_autoscroll(i2c_lcd_pcf8574_handle_t* lcd);
+esp_err_t lcd_autoscroll(i2c_lcd_pcf8574_handle_t* lcd);
+esp_err_t lcd_no_autoscroll(i2c_lcd_pcf8574_handle_t* lcd);
 
 // Set backlight brightness
-void lcd_set_backlight(i2c_lcd_pcf8574_handle_t* lcd, uint8_t brightness);
+esp_err_t lcd_set_backlight(i2c_lcd_pcf8574_handle_t* lcd, uint8_t brightness);
 
 // Create a custom character
-void lcd_create_char(i2c_lcd_pcf8574_handle_t* lcd, uint8_t location, uint8_t charmap[]);
+esp_err_t lcd_create_char(i2c_lcd_pcf8574_handle_t* lcd, uint8_t location, uint8_t charmap[]);
 
 // Write a character to the LCD
-void lcd_write(i2c_lcd_pcf8574_handle_t* lcd, uint8_t value);
+esp_err_t lcd_write(i2c_lcd_pcf8574_handle_t* lcd, uint8_t value);
 
 // Print a string to the LCD
-void lcd_print(i2c_lcd_pcf8574_handle_t* lcd, const char* str);
+esp_err_t lcd_print(i2c_lcd_pcf8574_handle_t* lcd, const char* str);
+
+esp_err_t lcd_print_number(i2c_lcd_pcf8574_handle_t* lcd, uint8_t col, uint8_t row, uint8_t buf_len, const char *str, ...);
+
+// Set up a numeric field: `decimals` > 0 shows the value as fixed point (1234 with 2 decimals is "12.34")
+void lcd_field_init(lcd_field_t* field, uint8_t col, uint8_t row, uint8_t width, uint8_t decimals, lcd_align_t align);
+
+// Show a new value in a field, only the characters that differ from the previous value are sent
+esp_err_t lcd_field_update(i2c_lcd_pcf8574_handle_t* lcd, lcd_field_t* field, int32_t value);
+
+// Set up a bar of len cells for values from min to max
+void lcd_bar_init(lcd_bar_t* bar, uint8_t col, uint8_t row, uint8_t len, lcd_bar_dir_t dir, int32_t min, int32_t max);
+
+// Show a new value: only the cells whose fill level changed are sent
+esp_err_t lcd_bar_update(i2c_lcd_pcf8574_handle_t* lcd, lcd_bar_t* bar, int32_t value);
+
+// Set up a sparkline of width x height cells for values from min to max
+void lcd_sparkline_init(lcd_sparkline_t* spark, uint8_t col, uint8_t row, uint8_t width, uint8_t height,
+                        int32_t min, int32_t max);
+
+// Add a sample: the line moves one column to the left, only the cells that change are sent
+esp_err_t lcd_sparkline_push(i2c_lcd_pcf8574_handle_t* lcd, lcd_sparkline_t* spark, int32_t value);
+
+// Change the PCF8574 pin assignment (defaults: RS=0x01, RW=0x02, E=0x04, BL=0x08, D4..D7=0x10..0x80)
+esp_err_t lcd_set_pin_map(i2c_lcd_pcf8574_handle_t* lcd, uint8_t rs_mask, uint8_t rw_mask, uint8_t enable_mask,
+                          uint8_t backlight_mask, const uint8_t data_mask[4]);
+
+// Drive the display in 8-bit mode through a 16-bit expander, one E pulse per byte (call before lcd_begin()).
+// The RS, RW, E and backlight masks are bits of the control port, data_mask[i] is the data port bit of
+// D<i> (NULL: D0..D7 on bits 0..7). LCD_EXPANDER_PCF8574 goes back to the default PCF8574 pin map.
+esp_err_t lcd_set_expander(i2c_lcd_pcf8574_handle_t* lcd, lcd_expander_t expander, uint8_t rs_mask, uint8_t rw_mask,
+                           uint8_t enable_mask, uint8_t backlight_mask, const uint8_t data_mask[8]);
+
+// Send through another transport (call before lcd_begin()). lcd_init() sets up the legacy I2C driver,
+// or nothing with CONFIG_LCD_PCF8574_I2C_MASTER.
+esp_err_t lcd_set_transport(i2c_lcd_pcf8574_handle_t* lcd, const lcd_transport_t* transport);
+
+#if CONFIG_LCD_PCF8574_I2C_LEGACY
+// Transport through the legacy I2C driver (driver/i2c.h) to the device at addr on port
+void lcd_transport_legacy(lcd_transport_t* transport, lcd_legacy_bus_t* bus, i2c_port_t port, uint8_t addr);
+#endif
+
+#if CONFIG_LCD_PCF8574_I2C_MASTER
+// Transport through a device of the I2C master driver (driver/i2c_master.h), see i2c_master_bus_add_device()
+void lcd_transport_i2c_master(lcd_transport_t* transport, i2c_master_dev_handle_t dev);
+#endif
+
+#if CONFIG_LCD_PCF8574_I2C_MASTER
+// Transport through a device on a master bus set up with trans_queue_depth >= LCD_MASTER_ASYNC_DEPTH.
+// Registers the completion callback of the device, frames of lcd_stream_frame() don't block.
+esp_err_t lcd_transport_i2c_master_async(lcd_transport_t* transport, lcd_master_async_t* async, i2c_master_dev_handle_t dev);
+#endif
+
+// Transport that collects the bytes in buf instead of sending them, see lcd_capture_t
+void lcd_transport_capture(lcd_transport_t* transport, lcd_capture_t* capture, uint8_t* buf, size_t size);
+
+// Set the timeout of each I2C transaction (default LCD_DEFAULT_TIMEOUT_MS)
+esp_err_t lcd_set_timeout(i2c_lcd_pcf8574_handle_t* lcd, uint32_t timeout_ms);
+
+// After `threshold` failed transactions in a row (0 never) the display goes offline: writes fail with
+// ESP_ERR_INVALID_STATE without touching the bus, and the display is probed with a backoff doubling
+// from backoff_min_ms up to backoff_max_ms. When it answers it is initialized again and gets back its
+// display and entry mode, custom characters and framebuffer content.
+esp_err_t lcd_set_circuit_breaker(i2c_lcd_pcf8574_handle_t* lcd, uint8_t threshold, uint32_t backoff_min_ms, uint32_t backoff_max_ms);
+
+// Check if the circuit breaker took the display offline
+bool lcd_is_offline(const i2c_lcd_pcf8574_handle_t* lcd);
+
+// Poll the busy flag instead of waiting worst case times (needs RW wired, checked when enabling).
+// With the pin map of lcd_init() RW is taken to be on P1.
+esp_err_t lcd_set_busy_polling(i2c_lcd_pcf8574_handle_t* lcd, bool enable);
+
+// Read the controller's address counter (needs busy flag polling)
+esp_err_t lcd_read_address_counter(i2c_lcd_pcf8574_handle_t* lcd, uint8_t* address);
+
+// Encode bytes into the expander wire sequence (4 bytes per input byte), returns the number of bytes written
+size_t lcd_encode_bytes(const i2c_lcd_pcf8574_handle_t* lcd, const uint8_t* src, size_t len, bool is_data, uint8_t* out);
+
+// Start collecting LCD operations into a single I2C transaction (calls may be nested)
+esp_err_t lcd_batch_begin(i2c_lcd_pcf8574_handle_t* lcd);
+
+// Send all LCD operations collected since lcd_batch_begin() in one I2C transaction
+esp_err_t lcd_batch_commit(i2c_lcd_pcf8574_handle_t* lcd);
+
+// Write a buffer of bytes to the LCD in a single I2C transaction
+esp_err_t lcd_write_buffer(i2c_lcd_pcf8574_handle_t* lcd, const uint8_t* data, size_t len);
+
+// Write characters that are encoded already: 4 expander bytes per character as lcd_encode_bytes() gives
+// them with the backlight off (or a table built at compile time for the same pin map), the backlight
+// bits are added while sending
+esp_err_t lcd_write_encoded(i2c_lcd_pcf8574_handle_t* lcd, const uint8_t* wire, size_t len);
+
+// Framebuffer drawing: these only change RAM, nothing is sent until lcd_flush()
+void lcd_fb_clear(i2c_lcd_pcf8574_handle_t* lcd);
+void lcd_fb_write(i2c_lcd_pcf8574_handle_t* lcd, uint8_t col, uint8_t row, uint8_t value);
+void lcd_fb_print(i2c_lcd_pcf8574_handle_t* lcd, uint8_t col, uint8_t row, const char* str);
+
+// Put a 5x8 custom character into the framebuffer. The glyph cache uploads it into a CGRAM slot
+// only if no slot holds the same bitmap, evicting the least recently used slot not on screen.
+esp_err_t lcd_fb_put_glyph(i2c_lcd_pcf8574_handle_t* lcd, uint8_t col, uint8_t row, const uint8_t bitmap[8]);
+
+// Forget what is on the display, so the next lcd_flush() rewrites every cell
+void lcd_fb_invalidate(i2c_lcd_pcf8574_handle_t* lcd);
+
+// Send the framebuffer cells that differ from the display with as few commands as possible
+esp_err_t lcd_flush(i2c_lcd_pcf8574_handle_t* lcd);
+
+// Send at most max_cells of the differing cells, `sent` receives the number sent and `pending` tells if more are left
+esp_err_t lcd_flush_step(i2c_lcd_pcf8574_handle_t* lcd, size_t max_cells, size_t* sent, bool* pending);
+
+// Draw the framebuffer on the off-screen half of the DDRAM lines, then shift it into view, so the
+// new screen appears at once (up to 2 rows of up to 20 columns). lcd_flush() and the direct functions
+// keep working on the page shown. Don't mix with lcd_scroll_display_*() or lcd_autoscroll().
+esp_err_t lcd_page_flip(i2c_lcd_pcf8574_handle_t* lcd);
+
+// Start scrolling the rows given to lcd_marquee_set_text() from an esp_timer. Until lcd_marquee_stop()
+// the timer callback owns the display: don't use other functions on the handle meanwhile. The steps
+// run in the esp_timer task shared by all timers: a step takes a flush, up to 1.6ms for the return
+// home after a failure, and holds back the other timer callbacks for that long.
+esp_err_t lcd_marquee_start(lcd_marquee_t* marquee, i2c_lcd_pcf8574_handle_t* lcd);
+
+// Show a text on a row, from any task. A text longer than the display scrolls one column every
+// interval_ms, a shorter one stands still. The text is not copied, it must stay valid while it is
+// shown. NULL leaves the row as it is.
+esp_err_t lcd_marquee_set_text(lcd_marquee_t* marquee, uint8_t row, const char* text, uint32_t interval_ms);
+
+// Stop the timer, wait for a step that is running and set the display shift back to 0, the
+// framebuffer holds what the rows show. Not from a timer callback.
+esp_err_t lcd_marquee_stop(lcd_marquee_t* marquee);
+
+// Attach a write ring to the handle: producers use lcd_ring_post(), one consumer calls lcd_ring_drain()
+void lcd_ring_attach(i2c_lcd_pcf8574_handle_t* lcd, lcd_write_ring_t* ring);
+
+// Queue a positioned write from any task or core without locking, fails when the ring is full
+esp_err_t lcd_ring_post(i2c_lcd_pcf8574_handle_t* lcd, uint8_t col, uint8_t row, const char* str);
+
+// Apply the queued writes in order and flush, `applied` (may be NULL) receives the number of writes applied
+esp_err_t lcd_ring_drain(i2c_lcd_pcf8574_handle_t* lcd, size_t* applied);
+
+// Set up a bus scheduler for the displays on one I2C port, each gets up to `quantum` cells per turn
+void lcd_bus_init(lcd_bus_scheduler_t* bus, i2c_port_t i2c_port, uint16_t quantum);
+
+// Add a display (after lcd_begin()) to the bus scheduler
+esp_err_t lcd_bus_add(lcd_bus_scheduler_t* bus, i2c_lcd_pcf8574_handle_t* lcd);
+
+// Give every display with pending framebuffer changes one turn, returns true while work is left
+bool lcd_bus_service(lcd_bus_scheduler_t* bus);
+
+// Flush the framebuffers of all displays, interleaving them while controllers are busy.
+// Returns the first error of any display, the others are still served.
+esp_err_t lcd_bus_flush_all(lcd_bus_scheduler_t* bus);
+
+// Read the statistics of the display at `index` (order of lcd_bus_add())
+esp_err_t lcd_bus_get_stats(lcd_bus_scheduler_t* bus, uint8_t index, lcd_bus_stats_t* stats);
+
+// Reset the statistics of all displays
+void lcd_bus_reset_stats(lcd_bus_scheduler_t* bus);
+
+// Start a task that owns the display: after this only use the lcd_render_* calls on the handle
+esp_err_t lcd_render_start(i2c_lcd_pcf8574_handle_t* lcd, const lcd_render_config_t* config);
+
+// Stop the render task once the queued updates are on the display
+void lcd_render_stop(i2c_lcd_pcf8574_handle_t* lcd);
+
+// Queue text for the render task and return immediately. Queued text for the same row and columns
+// is replaced or merged, so the queue holds one update per region.
+esp_err_t lcd_render_post(i2c_lcd_pcf8574_handle_t* lcd, uint8_t col, uint8_t row, const char* str);
+
+// Queue a clear of the whole screen for the render task
+esp_err_t lcd_render_post_clear(i2c_lcd_pcf8574_handle_t* lcd);
+
+// Read the render task statistics
+void lcd_render_get_stats(i2c_lcd_pcf8574_handle_t* lcd, lcd_render_stats_t* stats);
+
+// Save what the display shows and its set-up to state, RAM only. Call after the last change
+// before a soft reset or deep sleep.
+void lcd_warm_save(const i2c_lcd_pcf8574_handle_t* lcd, lcd_warm_state_t* state);
+
+// Attach to a display that stayed powered: with a valid state of the same display the reset
+// sequence and the clear are skipped, the framebuffer starts with what the display shows and
+// *warm is set. Falls back to lcd_begin() otherwise.
+esp_err_t lcd_begin_warm(i2c_lcd_pcf8574_handle_t* lcd, uint8_t cols, uint8_t rows, const lcd_warm_state_t* state, bool* warm);
+
+// Set up frame streaming for a display. done (may be NULL) is called with arg for every frame.
+esp_err_t lcd_stream_init(lcd_stream_t* stream, i2c_lcd_pcf8574_handle_t* lcd, lcd_transport_done_t done, void* arg);
+
+// Encode the framebuffer changes into a frame and hand it to the transport. Returns without
+// waiting for the bus if the transport has write_async, ESP_ERR_NOT_FINISHED while two frames
+// are still on the way. A frame that failed on the way is reported by the next call.
+esp_err_t lcd_stream_frame(lcd_stream_t* stream);
+
+// Wait until every frame is on the display, returns the error of a frame that failed on the way
+esp_err_t lcd_stream_wait(lcd_stream_t* stream, uint32_t timeout_ms);
+
+// Set up a console on the whole display. Text comes in at the bottom row and scrolls up; wrap
+// continues text longer than a row on the next row, else it is cut off. Flushes are at least
+// min_interval_ms apart (0: every write flushes), lcd_console_poll() sends what was held back.
+// The console owns the display: don't use other functions on the handle meanwhile.
+esp_err_t lcd_console_init(lcd_console_t* console, i2c_lcd_pcf8574_handle_t* lcd, bool wrap, uint32_t min_interval_ms);
+
+// Write text, from any task. '\n' ends a line, '\r' starts it again, ANSI escape sequences are
+// skipped. A line equal to the one before adds to its repeat counter instead of scrolling.
+esp_err_t lcd_console_write(lcd_console_t* console, const char* text, size_t len);
+
+// Write formatted text (up to LCD_CONSOLE_TEXT_MAX - 1 characters)
+esp_err_t lcd_console_printf(lcd_console_t* console, const char* format, ...);
+
+// Flush what the rate limit held back once it is due, call periodically with a rate limit set
+esp_err_t lcd_console_poll(lcd_console_t* console);
+
+// Send the log output (esp_log) to a console as well, NULL stops it
+void lcd_console_set_log_sink(lcd_console_t* console);
+
+// vprintf-style sink (see esp_log_set_vprintf()): writes to the console of lcd_console_set_log_sink()
+// and passes the text on to the sink installed before
+int lcd_console_vprintf(const char* format, va_list args);
+
+// Take a snapshot of the performance counters (all zero without CONFIG_LCD_PCF8574_PERF_COUNTERS)
+void lcd_perf_get(i2c_lcd_pcf8574_handle_t* lcd, lcd_perf_t* perf);
+
+// Reset the performance counters
+void lcd_perf_reset(i2c_lcd_pcf8574_handle_t* lcd);
 
-void lcd_print_number(i2c_lcd_pcf8574_handle_t* lcd, uint8_t col, uint8_t row, uint8_t buf_len, const char *str, ...);
+// Call from the esp_heap_trace_alloc_hook() of the application for each display: aborts if the
+// allocating task is inside a driver call of the display after lcd_begin() (does nothing without
+// CONFIG_LCD_PCF8574_ASSERT_NO_ALLOC)
+void lcd_check_alloc(const i2c_lcd_pcf8574_handle_t* lcd);
 
 
 #ifdef __cplusplus
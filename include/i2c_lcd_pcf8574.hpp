@@ -0,0 +1,297 @@
+/// \file i2c_lcd_pcf8574.hpp
+/// \brief C++ front end of the i2c_lcd_pcf8574 driver with compile-time geometry and pin map
+///
+/// The display size and the PCF8574 pin assignment are template parameters: a geometry the
+/// controller can't address or a pin map with shared pins doesn't compile, row offsets and the
+/// nibble encoding table are constexpr, and text known at compile time is encoded by the compiler.
+/// Header only, needs C++20 (the default of ESP-IDF 5).
+///
+/// \author Femi Olugbon, https://iamflinks.github.io
+/// \copyright Copyright (c) 2024 by Femi Olugbon
+///
+/// ChangeLog see: i2c_lcd_pcf8574.h
+
+#pragma once
+
+#ifndef I2C_LCD_PCF8574_HPP
+#define I2C_LCD_PCF8574_HPP
+
+#if __cplusplus < 202002L
+#error "i2c_lcd_pcf8574.hpp needs C++20"
+#endif
+
+#include <array>
+#include <cassert>
+#include <cstdarg>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <span>
+#include <string_view>
+#include <type_traits>
+#include "i2c_lcd_pcf8574.h"
+
+
+namespace i2c_lcd_pcf8574 {
+
+// PCF8574 pin assignment: the expander bit of each LCD signal
+struct pin_map {
+    uint8_t rs;
+    uint8_t rw;
+    uint8_t enable;
+    uint8_t backlight;
+    std::array<uint8_t, 4> data;    // D4..D7
+
+    constexpr bool operator==(const pin_map&) const = default;
+};
+
+// The common backpack and the default of the C driver: RS=P0, RW=P1, E=P2, BL=P3, D4..D7=P4..P7
+inline constexpr pin_map standard_pins{ 0x01, 0x02, 0x04, 0x08, { 0x10, 0x20, 0x40, 0x80 } };
+
+// Expander bytes per [command/data][nibble][E high/E low], without backlight
+using nibble_table = std::array<std::array<std::array<uint8_t, 2>, 16>, 2>;
+
+// Encoded characters: 4 expander bytes each, see lcd_write_encoded()
+template <std::size_t N>
+using encoded_text = std::array<uint8_t, 4 * N>;
+
+// Every signal needs a pin of its own
+constexpr bool pin_map_valid(const pin_map& pins) {
+    const uint8_t masks[] = { pins.rs, pins.rw, pins.enable, pins.backlight,
+                              pins.data[0], pins.data[1], pins.data[2], pins.data[3] };
+    uint8_t used = 0;
+    for (uint8_t mask : masks) {
+        if (mask == 0 || (mask & (mask - 1)) != 0 || (used & mask) != 0) {
+            return false;
+        }
+        used |= mask;
+    }
+    return true;
+}  // pin_map_valid()
+
+// The same table the C driver builds at runtime in lcd_set_pin_map()
+constexpr nibble_table make_nibble_table(const pin_map& pins) {
+    nibble_table table{};
+    for (uint8_t half_byte = 0; half_byte < 16; half_byte++) {
+        uint8_t data = 0;
+        for (uint8_t bit = 0; bit < 4; bit++) {
+            if (half_byte & (1 << bit)) {
+                data |= pins.data[bit];
+            }
+        }
+        table[0][half_byte] = { static_cast<uint8_t>(data | pins.enable), data };
+        table[1][half_byte] = { static_cast<uint8_t>(data | pins.rs | pins.enable),
+                                static_cast<uint8_t>(data | pins.rs) };
+    }
+    return table;
+}  // make_nibble_table()
+
+
+// A display of Cols x Rows characters behind a PCF8574 wired as Pins. The object holds the
+// C handle, handle() gives it to the rest of the C API. Movable but not copyable: move it only
+// while no render task, marquee or bus scheduler refers to the handle.
+template <uint8_t Cols, uint8_t Rows, pin_map Pins = standard_pins>
+class display {
+    static_assert(LCD_GEOMETRY_VALID(Cols, Rows),
+                  "The controller addresses 1 row of up to 80 columns, 2 rows of up to 40 or 3 to 4 rows of up to 20");
+    static_assert(pin_map_valid(Pins), "Each signal needs its own PCF8574 pin");
+#if CONFIG_LCD_PCF8574_FIXED_PINMAP
+    static_assert(Pins == standard_pins, "CONFIG_LCD_PCF8574_FIXED_PINMAP only drives the standard pin map");
+#endif
+    static_assert(std::is_trivially_copyable_v<i2c_lcd_pcf8574_handle_t>, "Moving copies the handle");
+
+public:
+    static constexpr uint8_t cols = Cols;
+    static constexpr uint8_t rows = Rows;
+    static constexpr pin_map pins = Pins;
+
+    // DDRAM address of the first column of each row, same as lcd_begin() sets up
+    static constexpr std::array<uint8_t, Rows> row_offsets = [] {
+        const uint8_t offsets[LCD_MAX_ROWS] = { 0x00, 0x40, Cols, 0x40 + Cols };
+        std::array<uint8_t, Rows> result{};
+        for (uint8_t row = 0; row < Rows; row++) {
+            result[row] = offsets[row];
+        }
+        return result;
+    }();
+
+    static constexpr nibble_table nibbles = make_nibble_table(Pins);
+
+    // Text of one row: a fixed size buffer, never on the heap
+    using row_buffer = std::array<char, Cols>;
+
+    // Wire bytes of one character, without backlight
+    static constexpr encoded_text<1> encode(uint8_t value) {
+        const auto& hi = nibbles[1][value >> 4];
+        const auto& lo = nibbles[1][value & 0x0F];
+        return { hi[0], hi[1], lo[0], lo[1] };
+    }  // encode()
+
+    // Encode a string literal at compile time: constexpr auto title = lcd_t::encode("Title");
+    template <std::size_t N>
+    static constexpr encoded_text<N - 1> encode(const char (&text)[N]) {
+        static_assert(N - 1 <= LCD_DDRAM_SIZE, "Longer than the display data RAM");
+        encoded_text<N - 1> wire{};
+        for (std::size_t i = 0; i < N - 1; i++) {
+            const encoded_text<1> c = encode(static_cast<uint8_t>(text[i]));
+            for (std::size_t j = 0; j < 4; j++) {
+                wire[4 * i + j] = c[j];
+            }
+        }
+        return wire;
+    }  // encode()
+
+    // DDRAM address of a position checked at compile time
+    template <uint8_t Col, uint8_t Row>
+    static constexpr uint8_t address() {
+        static_assert(Col < Cols && Row < Rows, "Position outside of the display");
+        return row_offsets[Row] + Col;
+    }  // address()
+
+    // Set up the handle, nothing is sent before begin()
+    display(uint8_t i2c_addr, i2c_port_t i2c_port) {
+        err_ = lcd_init(&lcd_, i2c_addr, i2c_port);
+#if !CONFIG_LCD_PCF8574_FIXED_PINMAP
+        if (err_ == ESP_OK) {
+            err_ = lcd_set_pin_map(&lcd_, Pins.rs, Pins.rw, Pins.enable, Pins.backlight, Pins.data.data());
+        }
+#endif
+    }
+
+    display(const display&) = delete;
+    display& operator=(const display&) = delete;
+
+    // The moved-from display may only be destroyed or assigned to
+    display(display&& other) noexcept : lcd_(other.lcd_), err_(other.err_) {
+        assert(other.lcd_.render_task == nullptr);
+        rebase_transport(other);
+        other.err_ = ESP_ERR_INVALID_STATE;
+    }
+
+    display& operator=(display&& other) noexcept {
+        assert(other.lcd_.render_task == nullptr && lcd_.render_task == nullptr);
+        lcd_ = other.lcd_;
+        err_ = other.err_;
+        rebase_transport(other);
+        other.err_ = ESP_ERR_INVALID_STATE;
+        return *this;
+    }
+
+    // Initialize the controller
+    esp_err_t begin() {
+        return err_ != ESP_OK ? err_ : lcd_begin(&lcd_, Cols, Rows);
+    }  // begin()
+
+    esp_err_t clear() { return lcd_clear(&lcd_); }
+    esp_err_t home() { return lcd_home(&lcd_); }
+    esp_err_t set_backlight(uint8_t brightness) { return lcd_set_backlight(&lcd_, brightness); }
+    esp_err_t set_display(bool on) { return on ? lcd_display(&lcd_) : lcd_no_display(&lcd_); }
+    esp_err_t set_cursor_visible(bool on) { return on ? lcd_cursor(&lcd_) : lcd_no_cursor(&lcd_); }
+    esp_err_t set_blink(bool on) { return on ? lcd_blink(&lcd_) : lcd_no_blink(&lcd_); }
+
+    // Move the cursor to a position checked at compile time
+    template <uint8_t Col, uint8_t Row>
+    esp_err_t set_cursor() {
+        static_assert(Col < Cols && Row < Rows, "Position outside of the display");
+        return lcd_set_cursor(&lcd_, Col, Row);
+    }  // set_cursor()
+
+    // Move the cursor, a position outside of the display fails instead of being clamped
+    esp_err_t set_cursor(uint8_t col, uint8_t row) {
+        if (col >= Cols || row >= Rows) {
+            return ESP_ERR_INVALID_ARG;
+        }
+        return lcd_set_cursor(&lcd_, col, row);
+    }  // set_cursor()
+
+    // Write text at the cursor in one transaction, encoded with the compile-time table
+    esp_err_t write(std::string_view text) {
+        return write_bytes(reinterpret_cast<const uint8_t*>(text.data()), text.size());
+    }  // write()
+
+    esp_err_t write(std::span<const uint8_t> bytes) {
+        return write_bytes(bytes.data(), bytes.size());
+    }  // write()
+
+    // Write text encoded by encode() at compile time
+    template <std::size_t M>
+    esp_err_t write_encoded(const std::array<uint8_t, M>& wire) {
+        static_assert(M % 4 == 0, "Encoded text has 4 bytes per character");
+        return lcd_write_encoded(&lcd_, wire.data(), M);
+    }  // write_encoded()
+
+    // Write text at a position, cut off at the end of the row
+    esp_err_t print_at(uint8_t col, uint8_t row, std::string_view text) {
+        if (col >= Cols || row >= Rows) {
+            return ESP_ERR_INVALID_ARG;
+        }
+        lcd_batch_begin(&lcd_);
+        lcd_set_cursor(&lcd_, col, row);
+        write(text.substr(0, Cols - col));
+        return lcd_batch_commit(&lcd_);
+    }  // print_at()
+
+    // Formatted text at a position, cut off at the end of the row
+    esp_err_t printf_at(uint8_t col, uint8_t row, const char* format, ...) __attribute__((format(printf, 4, 5))) {
+        char text[Cols + 1];
+        va_list args;
+        va_start(args, format);
+        const int len = std::vsnprintf(text, sizeof(text), format, args);
+        va_end(args);
+        if (len < 0) {
+            return ESP_ERR_INVALID_ARG;
+        }
+        return print_at(col, row, std::string_view(text, len < Cols ? len : Cols));
+    }  // printf_at()
+
+    // Framebuffer drawing: RAM only until flush() or page_flip()
+    void fb_clear() { lcd_fb_clear(&lcd_); }
+
+    void fb_print(uint8_t col, uint8_t row, std::string_view text) {
+        for (std::size_t i = 0; i < text.size() && col + i < Cols; i++) {
+            lcd_fb_write(&lcd_, col + i, row, static_cast<uint8_t>(text[i]));
+        }
+    }  // fb_print()
+
+    esp_err_t flush() { return lcd_flush(&lcd_); }
+    esp_err_t page_flip() { return lcd_page_flip(&lcd_); }
+
+    i2c_lcd_pcf8574_handle_t* handle() { return &lcd_; }
+    const i2c_lcd_pcf8574_handle_t* handle() const { return &lcd_; }
+
+private:
+    // The default transport points into the handle, the copy has to point into its own
+    void rebase_transport(const display& other) {
+#if CONFIG_LCD_PCF8574_I2C_LEGACY
+        if (lcd_.transport.ctx == &other.lcd_.legacy) {
+            lcd_.transport.ctx = &lcd_.legacy;
+        }
+#endif
+    }  // rebase_transport()
+
+    // Encode a row's worth of characters at a time on the stack, all in one batch
+    esp_err_t write_bytes(const uint8_t* data, std::size_t len) {
+        encoded_text<Cols> wire;
+        lcd_batch_begin(&lcd_);
+        while (len > 0) {
+            const std::size_t n = len < Cols ? len : Cols;
+            for (std::size_t i = 0; i < n; i++) {
+                const encoded_text<1> c = encode(data[i]);
+                for (std::size_t j = 0; j < 4; j++) {
+                    wire[4 * i + j] = c[j];
+                }
+            }
+            lcd_write_encoded(&lcd_, wire.data(), 4 * n);
+            data += n;
+            len -= n;
+        }
+        return lcd_batch_commit(&lcd_);
+    }  // write_bytes()
+
+    i2c_lcd_pcf8574_handle_t lcd_{};
+    esp_err_t err_ = ESP_OK;
+};
+
+}  // namespace i2c_lcd_pcf8574
+
+#endif // I2C_LCD_PCF8574_HPP
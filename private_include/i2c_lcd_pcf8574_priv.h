@@ -0,0 +1,122 @@
+/// \file i2c_lcd_pcf8574_priv.h
+/// \brief Functions shared between the i2c_lcd_pcf8574 source files, not part of the public API
+///
+/// \author Femi Olugbon, https://iamflinks.github.io
+/// \copyright Copyright (c) 2024 by Femi Olugbon
+///
+/// ChangeLog see: i2c_lcd_pcf8574.h
+
+#pragma once
+
+#include "i2c_lcd_pcf8574.h"
+
+// Encode one byte as command (is_data = false) or character and queue it for the bus
+void lcd_send(i2c_lcd_pcf8574_handle_t* lcd, uint8_t value, bool is_data);
+
+// Marks sent_entrymode and sent_displaycontrol as unknown
+#define LCD_STATE_UNKNOWN 0xFF
+
+// Set the DDRAM address, unless the modeled address counter is there already
+void lcd_set_address(i2c_lcd_pcf8574_handle_t* lcd, uint8_t addr);
+
+// Send lcd->displaycontrol or lcd->entrymode, unless the controller has it already
+void lcd_send_displaycontrol(i2c_lcd_pcf8574_handle_t* lcd);
+void lcd_send_entrymode(i2c_lcd_pcf8574_handle_t* lcd);
+
+// Forget the modeled controller state after a reset or a failure: the next commands are all sent
+void lcd_forget_state(i2c_lcd_pcf8574_handle_t* lcd);
+
+// Send the pending bytes of the open batch without closing it
+void lcd_batch_flush(i2c_lcd_pcf8574_handle_t* lcd);
+
+// Send expander bytes as one I2C transaction, bypassing the batch
+void lcd_transmit(i2c_lcd_pcf8574_handle_t* lcd, const uint8_t* bytes, size_t len);
+
+// A transaction failed: set the error of the running operation, count it for the circuit breaker
+void lcd_transmit_failed(i2c_lcd_pcf8574_handle_t* lcd, esp_err_t err);
+
+// The display runs in 8-bit mode behind a 16-bit expander: every expander byte pair is
+// (control port, data port), and a transaction starts with the register lcd->expander_reg
+#if CONFIG_LCD_PCF8574_FIXED_PINMAP
+#define LCD_EXPANDER_8BIT(lcd) false
+#else
+#define LCD_EXPANDER_8BIT(lcd) ((lcd)->expander != LCD_EXPANDER_PCF8574)
+#endif
+
+// Set up the ports of a 16-bit expander as outputs, called by lcd_begin()
+void lcd_expander_setup(i2c_lcd_pcf8574_handle_t* lcd);
+
+// End of a public operation: returns and clears its first bus error (outside of batches),
+// then restores the state of a display that came back
+esp_err_t lcd_finish(i2c_lcd_pcf8574_handle_t* lcd);
+
+// Return an error without logging it: bus errors are logged where they happen
+#define LCD_RETURN_ON_ERROR(x) do {     \
+        esp_err_t err_rc_ = (x);        \
+        if (err_rc_ != ESP_OK) {        \
+            return err_rc_;             \
+        }                               \
+    } while (0)
+
+#if CONFIG_LCD_PCF8574_ASSERT_NO_ALLOC
+// The calling task is inside a driver call of the display until the end of the enclosing block,
+// see lcd_check_alloc(). Calls nest.
+#define LCD_NO_ALLOC_SCOPE(lcd) \
+    i2c_lcd_pcf8574_handle_t* lcd_no_alloc_ __attribute__((cleanup(lcd_no_alloc_leave), unused)) = lcd_no_alloc_enter(lcd)
+i2c_lcd_pcf8574_handle_t* lcd_no_alloc_enter(i2c_lcd_pcf8574_handle_t* lcd);
+void lcd_no_alloc_leave(i2c_lcd_pcf8574_handle_t** lcd);
+// From here on driver calls must not allocate
+#define LCD_NO_ALLOC_ARM(lcd) ((lcd)->no_alloc = true)
+#else
+#define LCD_NO_ALLOC_SCOPE(lcd) do { } while (0)
+#define LCD_NO_ALLOC_ARM(lcd) ((void)0)
+#endif
+
+// Glyph cache: character code of a bitmap, uploaded into a CGRAM slot if needed.
+// -1 if every slot is on screen.
+int lcd_glyph_code(i2c_lcd_pcf8574_handle_t* lcd, const uint8_t bitmap[8], esp_err_t* err);
+
+// Return home and clear display show page 0 again, see lcd_page_flip()
+void lcd_page_reset(i2c_lcd_pcf8574_handle_t* lcd);
+
+// Note a slow instruction: the next bus access waits until `us` from now
+void lcd_set_busy(i2c_lcd_pcf8574_handle_t* lcd, uint32_t us);
+
+// Wait for the deadline set by lcd_set_busy(), yielding the core for long waits
+void lcd_wait_ready(i2c_lcd_pcf8574_handle_t* lcd);
+
+// Create the timer of lcd_wait_ready() once per handle, before lcd_begin() forbids heap allocations
+esp_err_t lcd_wait_setup(i2c_lcd_pcf8574_handle_t* lcd);
+
+#if CONFIG_LCD_PCF8574_PERF_COUNTERS
+// Count one finished I2C transaction
+void lcd_perf_transfer(i2c_lcd_pcf8574_handle_t* lcd, size_t bytes, int64_t duration_us, esp_err_t err);
+
+// Count time spent waiting for the controller, spinning or sleeping
+void lcd_perf_wait(i2c_lcd_pcf8574_handle_t* lcd, int64_t duration_us, bool sleeping);
+
+// Count characters or instructions sent to the controller. Word sized, so no lock is needed.
+#define LCD_PERF_COUNT(lcd, is_data, n) ((is_data) ? ((lcd)->perf.chars += (n)) : ((lcd)->perf.commands += (n)))
+#define LCD_PERF_ELIDED(lcd) ((lcd)->perf.elided++)
+#else
+static inline void lcd_perf_transfer(i2c_lcd_pcf8574_handle_t* lcd, size_t bytes, int64_t duration_us, esp_err_t err) {}
+static inline void lcd_perf_wait(i2c_lcd_pcf8574_handle_t* lcd, int64_t duration_us, bool sleeping) {}
+#define LCD_PERF_COUNT(lcd, is_data, n) ((void)0)
+#define LCD_PERF_ELIDED(lcd) ((void)0)
+#endif
+
+// Map a DDRAM address to its index in the handle's ddram[] mirror
+static inline uint8_t lcd_ddram_index(const i2c_lcd_pcf8574_handle_t* lcd, uint8_t addr) {
+    // In 2-line mode the second line starts at 0x40, in 1-line mode the 80 addresses are contiguous
+    if (lcd->lines > 1 && (addr & 0x40)) {
+        return 40 + (addr & 0x3F);
+    }
+    return addr;
+}  // lcd_ddram_index()
+
+// The display content is unknown: the next flush rewrites every cell
+static inline void lcd_ddram_invalidate(i2c_lcd_pcf8574_handle_t* lcd) {
+    lcd->ddram_valid = false;
+    lcd->flush_resync = 0;
+    lcd->page_stale = true;
+}  // lcd_ddram_invalidate()